@@ -0,0 +1,68 @@
+/*
+ * Increment scaling benchmark for sky::atomic_counter.
+ *
+ * Every thread increments the same counter in a tight loop. For every
+ * thread count it reports the total increments per second of a counter with
+ * one stripe and of a striped counter.
+ *
+ * Usage: atomic_counter [max_threads] [increments]
+ *   max_threads  The largest number of threads.
+ *                Defaults to the number of hardware threads.
+ *   increments   The number of increments per thread. Defaults to 10000000.
+ */
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "sky/atomic.hpp"
+#include "sky/timer.h"
+
+#include "../bench.hpp"
+
+namespace {
+
+const std::size_t stripes = 64;
+
+template<typename Counter>
+double run(unsigned threads, unsigned long increments)
+{
+    Counter counter(0);
+    std::vector<std::thread> workers;
+    bench::start_line start(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&counter, &start, increments] {
+            start.wait();
+            for (unsigned long i = 0; i < increments; ++i) ++counter;
+        });
+    }
+
+    start.start();
+    sky::timer timer;
+    for (auto &w : workers) w.join();
+    double seconds = std::chrono::duration<double>(timer.split()).count();
+    if (counter.load() != increments * threads) {
+        std::fprintf(stderr, "Lost increments.\n");
+    }
+    return increments * threads / seconds;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    unsigned max_threads = bench::argument(
+            argc, argv, 1, std::thread::hardware_concurrency());
+    if (max_threads == 0) max_threads = 1;
+    unsigned long increments = bench::argument(argc, argv, 2, 10000000);
+
+    std::printf("%7s %16s %16s\n", "threads", "single ops/s", "striped ops/s");
+    for (unsigned threads : bench::thread_counts(max_threads)) {
+        double single = run<sky::atomic_counter<unsigned long>>(
+                threads, increments);
+        double striped = run<sky::atomic_counter<unsigned long, stripes>>(
+                threads, increments);
+        std::printf("%7u %16.0f %16.0f\n", threads, single, striped);
+    }
+    return 0;
+}
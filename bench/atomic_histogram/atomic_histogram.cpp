@@ -0,0 +1,74 @@
+/*
+ * Recording cost benchmark for sky::atomic_histogram.
+ *
+ * Every thread records pseudo-random latencies into the same histogram in a
+ * tight loop. For every thread count it reports the nanoseconds per
+ * recorded value, for a histogram with one stripe and a striped one.
+ *
+ * Usage: atomic_histogram [max_threads] [samples]
+ *   max_threads  The largest number of threads.
+ *                Defaults to the number of hardware threads.
+ *   samples      The number of samples per thread. Defaults to 10000000.
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "sky/atomic_histogram.hpp"
+#include "sky/timer.h"
+
+#include "../bench.hpp"
+
+namespace {
+
+const std::size_t stripes = 16;
+
+template<typename Histogram>
+double run(unsigned threads, unsigned long samples)
+{
+    Histogram histogram;
+    std::vector<std::thread> workers;
+    bench::start_line start(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&histogram, &start, samples, t] {
+            // A cheap xorshift, so that generating samples costs little.
+            std::uint32_t x = 2463534242u + t;
+            start.wait();
+            for (unsigned long i = 0; i < samples; ++i) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                histogram.record(x >> (x & 31));
+            }
+        });
+    }
+
+    start.start();
+    sky::timer timer;
+    for (auto &w : workers) w.join();
+    double seconds = std::chrono::duration<double>(timer.split()).count();
+    if (histogram.load().count() != samples * threads) {
+        std::fprintf(stderr, "Lost samples.\n");
+    }
+    return seconds * 1e9 / samples;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    unsigned max_threads = bench::argument(
+            argc, argv, 1, std::thread::hardware_concurrency());
+    if (max_threads == 0) max_threads = 1;
+    unsigned long samples = bench::argument(argc, argv, 2, 10000000);
+
+    std::printf("%7s %14s %14s\n", "threads", "single ns/op", "striped ns/op");
+    for (unsigned threads : bench::thread_counts(max_threads)) {
+        double single = run<sky::atomic_histogram<>>(threads, samples);
+        double striped = run<sky::atomic_histogram<stripes>>(threads, samples);
+        std::printf("%7u %14.2f %14.2f\n", threads, single, striped);
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Phase transition benchmark for sky::barrier.
+ *
+ * Every thread calls arrive_and_wait() in a tight loop. For every thread
+ * count it reports the average time of a phase, from the arrival of the
+ * last thread in one phase to that of the last thread in the next.
+ *
+ * Usage: barrier [max_threads] [phases]
+ *   max_threads  The largest number of threads.
+ *                Defaults to the number of hardware threads.
+ *   phases       The number of phases per run. Defaults to 100000.
+ */
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "sky/barrier.h"
+#include "sky/timer.h"
+
+#include "../bench.hpp"
+
+namespace {
+
+double run(unsigned threads, unsigned long phases)
+{
+    unsigned long completions = 0;
+    sky::barrier barrier(threads, [&completions] { ++completions; });
+    std::vector<std::thread> workers;
+    bench::start_line start(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&barrier, &start, phases] {
+            start.wait();
+            for (unsigned long p = 0; p < phases; ++p) {
+                barrier.arrive_and_wait();
+            }
+        });
+    }
+
+    start.start();
+    sky::timer timer;
+    for (auto &w : workers) w.join();
+    double ns = std::chrono::duration<double, std::nano>(timer.split()).count();
+    if (completions != phases) std::fprintf(stderr, "Lost phases.\n");
+    return ns / phases;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    unsigned max_threads = bench::argument(
+            argc, argv, 1, std::thread::hardware_concurrency());
+    if (max_threads == 0) max_threads = 1;
+    unsigned long phases = bench::argument(argc, argv, 2, 100000);
+
+    std::printf("%7s %12s\n", "threads", "ns per phase");
+    for (unsigned threads : bench::thread_counts(max_threads)) {
+        std::printf("%7u %12.0f\n", threads, run(threads, phases));
+    }
+    return 0;
+}
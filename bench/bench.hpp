@@ -0,0 +1,135 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "sky/cpu.hpp"
+#include "sky/timer.h"
+
+namespace bench {
+
+typedef sky::timer::clock clock;
+
+/**
+ * @brief The current time, in clock ticks, for stamping messages.
+ */
+inline std::int64_t now_ticks()
+{
+    return clock::now().time_since_epoch().count();
+}
+
+/**
+ * @brief Converts clock ticks to nanoseconds.
+ */
+inline double ticks_to_ns(double ticks)
+{
+    return ticks * 1e9 * clock::period::num / clock::period::den;
+}
+
+/**
+ * @brief A message of a given size that carries the time it was sent.
+ */
+template<std::size_t Size>
+struct message
+{
+    static_assert(Size >= sizeof(std::int64_t), "Message is too small.");
+
+    std::int64_t stamp;
+    char payload[Size - sizeof(std::int64_t)];
+};
+
+template<>
+struct message<sizeof(std::int64_t)>
+{
+    std::int64_t stamp;
+};
+
+/**
+ * @brief Releases a group of threads at the same time, so that thread
+ * creation does not count towards the measurement.
+ */
+class start_line
+{
+public:
+    explicit start_line(unsigned threads) : waiting(threads), go(false) {}
+
+    void wait()
+    {
+        waiting.fetch_sub(1, std::memory_order_acq_rel);
+        sky::spin_wait spin;
+        while (!go.load(std::memory_order_acquire)) spin.wait();
+    }
+
+    void start()
+    {
+        sky::spin_wait spin;
+        while (waiting.load(std::memory_order_acquire) != 0) spin.wait();
+        go.store(true, std::memory_order_release);
+    }
+
+private:
+    std::atomic<unsigned> waiting;
+    std::atomic<bool> go;
+};
+
+/**
+ * @brief The latency percentiles of a run, in nanoseconds.
+ */
+struct latency
+{
+    double p50;
+    double p99;
+    double p999;
+};
+
+/**
+ * @brief Computes the latency percentiles of a set of samples.
+ * @param samples Latencies in clock ticks. Reordered.
+ */
+inline latency percentiles(std::vector<std::int64_t> &samples)
+{
+    latency result = {0, 0, 0};
+    if (samples.empty()) return result;
+    auto at = [&samples](double p) {
+        auto nth = samples.begin() + std::size_t(p * (samples.size() - 1));
+        std::nth_element(samples.begin(), nth, samples.end());
+        return ticks_to_ns(double(*nth));
+    };
+    result.p50 = at(0.5);
+    result.p99 = at(0.99);
+    result.p999 = at(0.999);
+    return result;
+}
+
+/**
+ * @brief The thread counts to sweep: 1, 2, 4, ... up to max, and max itself.
+ */
+inline std::vector<unsigned> thread_counts(unsigned max)
+{
+    std::vector<unsigned> counts;
+    for (unsigned n = 1; n < max; n *= 2) counts.push_back(n);
+    counts.push_back(max);
+    return counts;
+}
+
+/**
+ * @brief Reads an optional positive integer from the command line.
+ */
+inline unsigned long argument(int argc, char **argv, int index,
+                              unsigned long fallback)
+{
+    if (argc <= index) return fallback;
+    unsigned long value = std::strtoul(argv[index], nullptr, 10);
+    return value > 0 ? value : fallback;
+}
+
+} // namespace bench
+
+#endif // BENCH_HPP
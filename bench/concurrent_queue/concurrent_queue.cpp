@@ -0,0 +1,109 @@
+/*
+ * Producer/consumer benchmark for sky::concurrent_queue.
+ *
+ * Sweeps the number of producers and consumers, the size of the elements and
+ * the capacity of the queue. For every combination it reports the throughput
+ * and the percentiles of the time from push to pop.
+ *
+ * Usage: concurrent_queue [max_threads] [messages]
+ *   max_threads  The largest number of producers and of consumers.
+ *                Defaults to the number of hardware threads.
+ *   messages     The number of messages per run. Defaults to 200000.
+ */
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "sky/concurrent_queue.hpp"
+#include "sky/timer.h"
+
+#include "../bench.hpp"
+
+namespace {
+
+template<std::size_t Size>
+void run(unsigned producers, unsigned consumers, std::size_t capacity,
+         unsigned long messages)
+{
+    typedef bench::message<Size> message_type;
+
+    sky::concurrent_queue<message_type> queue(capacity);
+    std::vector<std::vector<std::int64_t>> samples(consumers);
+    std::vector<std::thread> threads;
+    bench::start_line start(producers + consumers);
+    unsigned long per_producer = messages / producers;
+
+    for (unsigned c = 0; c < consumers; ++c) {
+        samples[c].reserve(messages / consumers + per_producer);
+        threads.emplace_back([&queue, &samples, &start, c] {
+            std::vector<std::int64_t> &latencies = samples[c];
+            message_type m;
+            start.wait();
+            while (queue.wait_pop(m)) {
+                latencies.push_back(bench::now_ticks() - m.stamp);
+            }
+        });
+    }
+    for (unsigned p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, &start, per_producer] {
+            message_type m = message_type();
+            start.wait();
+            for (unsigned long i = 0; i < per_producer; ++i) {
+                m.stamp = bench::now_ticks();
+                queue.push(m);
+            }
+        });
+    }
+
+    start.start();
+    sky::timer timer;
+    for (unsigned p = 0; p < producers; ++p) threads[consumers + p].join();
+    queue.close();
+    for (unsigned c = 0; c < consumers; ++c) threads[c].join();
+    double seconds = std::chrono::duration<double>(timer.split()).count();
+
+    std::vector<std::int64_t> all;
+    all.reserve(per_producer * producers);
+    for (auto const& s : samples) all.insert(all.end(), s.begin(), s.end());
+    bench::latency lat = bench::percentiles(all);
+
+    std::printf("%9u %9u %6zu %8zu %14.0f %10.0f %10.0f %10.0f\n",
+                producers, consumers, Size, capacity,
+                per_producer * producers / seconds,
+                lat.p50, lat.p99, lat.p999);
+}
+
+template<std::size_t Size>
+void sweep(std::vector<unsigned> const& counts, unsigned long messages)
+{
+    static const std::size_t capacities[] = {64, 1024, 16384};
+    for (std::size_t capacity : capacities) {
+        for (unsigned producers : counts) {
+            for (unsigned consumers : counts) {
+                run<Size>(producers, consumers, capacity, messages);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    unsigned max_threads = bench::argument(
+            argc, argv, 1, std::thread::hardware_concurrency());
+    if (max_threads == 0) max_threads = 1;
+    unsigned long messages = bench::argument(argc, argv, 2, 200000);
+    std::vector<unsigned> counts = bench::thread_counts(max_threads);
+
+    std::printf("%9s %9s %6s %8s %14s %10s %10s %10s\n",
+                "producers", "consumers", "size", "capacity",
+                "ops/s", "p50 ns", "p99 ns", "p99.9 ns");
+    sweep<8>(counts, messages);
+    sweep<64>(counts, messages);
+    sweep<256>(counts, messages);
+    return 0;
+}
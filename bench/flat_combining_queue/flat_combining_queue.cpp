@@ -0,0 +1,89 @@
+/*
+ * Contention benchmark comparing sky::flat_combining_queue with the
+ * CAS-based sky::concurrent_queue.
+ *
+ * Every thread repeatedly pushes an element and then pops one, so that all
+ * threads hammer both ends of the same queue. The queue is half full to
+ * start with, so neither push nor pop has to wait. For every thread count it
+ * reports the throughput of both queues; the flat-combining queue overtakes
+ * the CAS-based one where the ratio exceeds 1.
+ *
+ * Usage: flat_combining_queue [max_threads] [operations]
+ *   max_threads  The largest number of threads.
+ *                Defaults to twice the number of hardware threads.
+ *   operations   The number of push/pop pairs per thread. Defaults to 200000.
+ */
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "sky/concurrent_queue.hpp"
+#include "sky/flat_combining_queue.hpp"
+#include "sky/timer.h"
+
+#include "../bench.hpp"
+
+namespace {
+
+const std::size_t capacity = 1024;
+
+template<typename Queue>
+double run(unsigned threads, unsigned long operations)
+{
+    typedef typename Queue::value_type message_type;
+
+    Queue queue(capacity);
+    for (std::size_t i = 0; i < capacity / 2; ++i) queue.push(message_type());
+
+    std::vector<std::thread> workers;
+    bench::start_line start(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&queue, &start, operations] {
+            message_type m = message_type();
+            start.wait();
+            for (unsigned long i = 0; i < operations; ++i) {
+                queue.push(m);
+                m = queue.pop();
+            }
+        });
+    }
+
+    start.start();
+    sky::timer timer;
+    for (auto &w : workers) w.join();
+    double seconds = std::chrono::duration<double>(timer.split()).count();
+    return 2.0 * operations * threads / seconds;
+}
+
+template<std::size_t Size>
+void sweep(std::vector<unsigned> const& counts, unsigned long operations)
+{
+    typedef bench::message<Size> message_type;
+    for (unsigned threads : counts) {
+        double cas = run<sky::concurrent_queue<message_type>>(
+                threads, operations);
+        double fc = run<sky::flat_combining_queue<message_type>>(
+                threads, operations);
+        std::printf("%7u %6zu %14.0f %14.0f %7.2f\n",
+                    threads, Size, cas, fc, fc / cas);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    unsigned max_threads = bench::argument(
+            argc, argv, 1, 2 * std::thread::hardware_concurrency());
+    if (max_threads == 0) max_threads = 1;
+    unsigned long operations = bench::argument(argc, argv, 2, 200000);
+    std::vector<unsigned> counts = bench::thread_counts(max_threads);
+
+    std::printf("%7s %6s %14s %14s %7s\n",
+                "threads", "size", "cas ops/s", "fc ops/s", "fc/cas");
+    sweep<8>(counts, operations);
+    sweep<64>(counts, operations);
+    return 0;
+}
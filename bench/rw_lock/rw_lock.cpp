@@ -0,0 +1,100 @@
+/*
+ * Read-side scaling benchmark for sky::rw_lock.
+ *
+ * Every thread takes the lock for reading in a tight loop, and for writing
+ * once every write_interval acquisitions, if at all. For every thread count
+ * it reports the wall time divided by the acquisitions of one thread, which
+ * stays flat for as long as the lock scales, for sky::rw_lock and for a
+ * pthread reader-writer lock, which, like std::shared_mutex, keeps a single
+ * reader count.
+ *
+ * Usage: rw_lock [max_threads] [acquisitions]
+ *   max_threads   The largest number of threads.
+ *                 Defaults to the number of hardware threads.
+ *   acquisitions  The number of acquisitions per thread. Defaults to 2000000.
+ */
+#include <pthread.h>
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "sky/rw_lock.h"
+#include "sky/timer.h"
+
+#include "../bench.hpp"
+
+namespace {
+
+const unsigned long write_interval = 1000;
+
+class pthread_lock
+{
+public:
+    pthread_lock() { pthread_rwlock_init(&rw, nullptr); }
+    ~pthread_lock() { pthread_rwlock_destroy(&rw); }
+
+    void lock() { pthread_rwlock_wrlock(&rw); }
+    void unlock() { pthread_rwlock_unlock(&rw); }
+    void lock_shared() { pthread_rwlock_rdlock(&rw); }
+    void unlock_shared() { pthread_rwlock_unlock(&rw); }
+
+private:
+    pthread_rwlock_t rw;
+};
+
+template<typename Lock>
+double run(unsigned threads, bool writes, unsigned long acquisitions)
+{
+    Lock lock;
+    unsigned long shared = 0;
+    std::vector<std::thread> workers;
+    bench::start_line start(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, writes, acquisitions] {
+            unsigned long seen = 0;
+            start.wait();
+            for (unsigned long i = 1; i <= acquisitions; ++i) {
+                if (writes && i % write_interval == 0) {
+                    lock.lock();
+                    ++shared;
+                    lock.unlock();
+                } else {
+                    lock.lock_shared();
+                    seen += shared;
+                    lock.unlock_shared();
+                }
+            }
+            if (seen == ~0ul) std::fprintf(stderr, "Unlikely.\n");
+        });
+    }
+
+    start.start();
+    sky::timer timer;
+    for (auto &w : workers) w.join();
+    double ns = std::chrono::duration<double, std::nano>(timer.split()).count();
+    return ns / acquisitions;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    unsigned max_threads = bench::argument(
+            argc, argv, 1, std::thread::hardware_concurrency());
+    if (max_threads == 0) max_threads = 1;
+    unsigned long acquisitions = bench::argument(argc, argv, 2, 2000000);
+
+    std::printf("%7s %16s %16s %16s %16s\n", "threads",
+                "rw_lock ns", "pthread ns",
+                "rw_lock+w ns", "pthread+w ns");
+    for (unsigned threads : bench::thread_counts(max_threads)) {
+        std::printf("%7u %16.1f %16.1f %16.1f %16.1f\n", threads,
+                    run<sky::rw_lock>(threads, false, acquisitions),
+                    run<pthread_lock>(threads, false, acquisitions),
+                    run<sky::rw_lock>(threads, true, acquisitions),
+                    run<pthread_lock>(threads, true, acquisitions));
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Acquire/release benchmark for sky::semaphore.
+ *
+ * Every thread acquires and releases the same semaphore in a tight loop,
+ * using it as a lock. For every thread count it reports the average time
+ * of an acquire/release pair, which is the uncontended cost with a single
+ * thread.
+ *
+ * Usage: semaphore [max_threads] [iterations]
+ *   max_threads  The largest number of threads.
+ *                Defaults to the number of hardware threads.
+ *   iterations   The number of acquire/release pairs per thread.
+ *                Defaults to 10000000.
+ */
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "sky/semaphore.h"
+#include "sky/timer.h"
+
+#include "../bench.hpp"
+
+namespace {
+
+double run(unsigned threads, unsigned long iterations)
+{
+    sky::semaphore semaphore(1);
+    unsigned long total = 0;
+    std::vector<std::thread> workers;
+    bench::start_line start(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&semaphore, &total, &start, iterations] {
+            start.wait();
+            for (unsigned long i = 0; i < iterations; ++i) {
+                semaphore.acquire();
+                ++total;
+                semaphore.release();
+            }
+        });
+    }
+
+    start.start();
+    sky::timer timer;
+    for (auto &w : workers) w.join();
+    double ns = std::chrono::duration<double, std::nano>(timer.split()).count();
+    if (total != iterations * threads) {
+        std::fprintf(stderr, "Lost increments.\n");
+    }
+    return ns / (iterations * threads);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    unsigned max_threads = bench::argument(
+            argc, argv, 1, std::thread::hardware_concurrency());
+    if (max_threads == 0) max_threads = 1;
+    unsigned long iterations = bench::argument(argc, argv, 2, 10000000);
+
+    std::printf("%7s %12s\n", "threads", "ns per pair");
+    for (unsigned threads : bench::thread_counts(max_threads)) {
+        std::printf("%7u %12.1f\n", threads, run(threads, iterations));
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * Lock throughput benchmark for the sky spinlocks.
+ *
+ * Every thread repeatedly takes a lock, updates shared data for a few
+ * cycles, releases it, and then works outside of the lock for a while. The
+ * shorter that outside work, the higher the contention. For every thread
+ * count and amount of outside work it reports the lock acquisitions per
+ * second of std::mutex, sky::semaphore and each spinlock.
+ *
+ * Usage: spinlock [max_threads] [acquisitions]
+ *   max_threads   The largest number of threads.
+ *                 Defaults to the number of hardware threads.
+ *   acquisitions  The number of acquisitions per thread. Defaults to 1000000.
+ */
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sky/cpu.hpp"
+#include "sky/semaphore.h"
+#include "sky/spinlock.hpp"
+#include "sky/timer.h"
+
+#include "../bench.hpp"
+
+namespace {
+
+const unsigned critical_work = 16;
+
+template<typename Lock>
+double run(unsigned threads, unsigned outside_work,
+           unsigned long acquisitions)
+{
+    Lock lock;
+    unsigned long shared = 0;
+    std::vector<std::thread> workers;
+    bench::start_line start(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, outside_work, acquisitions] {
+            start.wait();
+            for (unsigned long i = 0; i < acquisitions; ++i) {
+                {
+                    std::lock_guard<Lock> guard(lock);
+                    ++shared;
+                    for (unsigned w = 0; w < critical_work; ++w) {
+                        sky::cpu_relax();
+                    }
+                }
+                for (unsigned w = 0; w < outside_work; ++w) sky::cpu_relax();
+            }
+        });
+    }
+
+    start.start();
+    sky::timer timer;
+    for (auto &w : workers) w.join();
+    double seconds = std::chrono::duration<double>(timer.split()).count();
+    if (shared != acquisitions * threads) {
+        std::fprintf(stderr, "Lost updates.\n");
+    }
+    return acquisitions * threads / seconds;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    unsigned max_threads = bench::argument(
+            argc, argv, 1, std::thread::hardware_concurrency());
+    if (max_threads == 0) max_threads = 1;
+    unsigned long acquisitions = bench::argument(argc, argv, 2, 1000000);
+    static const unsigned outside_works[] = {0, 64, 1024};
+
+    std::printf("%7s %8s %12s %12s %12s %12s %12s %12s\n",
+                "threads", "outside", "mutex", "semaphore",
+                "ttas", "ticket", "mcs", "clh");
+    for (unsigned outside : outside_works) {
+        for (unsigned threads : bench::thread_counts(max_threads)) {
+            std::printf(
+                "%7u %8u %12.0f %12.0f %12.0f %12.0f %12.0f %12.0f\n",
+                threads, outside,
+                run<std::mutex>(threads, outside, acquisitions),
+                run<sky::semaphore>(threads, outside, acquisitions),
+                run<sky::ttas_spinlock>(threads, outside, acquisitions),
+                run<sky::ticket_spinlock>(threads, outside, acquisitions),
+                run<sky::mcs_spinlock>(threads, outside, acquisitions),
+                run<sky::clh_spinlock>(threads, outside, acquisitions));
+        }
+    }
+    return 0;
+}
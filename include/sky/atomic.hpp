@@ -2,12 +2,103 @@
 #define ATOMIC_HPP
 
 #include <atomic>
+#include <cstddef>
 #include <utility>
 #include <type_traits>
 
+#include "sky/cpu.hpp"
+
 namespace sky {
 
+namespace _ {
+
+// One cell of an atomic counter: its value, and its registered writers.
 template<typename T>
+struct counter_cell
+{
+    constexpr counter_cell(T val = 0) noexcept : value(val), writers(0) {}
+
+    std::atomic<T> value;
+    std::atomic<unsigned> writers;
+};
+
+// A cell that starts, and fills, a cache line of its own.
+template<typename T>
+struct alignas(cache_line_size) padded_counter_cell : counter_cell<T>
+{
+    constexpr padded_counter_cell(T val = 0) noexcept : counter_cell<T>(val) {}
+};
+
+/*
+ * The storage of an atomic counter: one cell per stripe. With more than one
+ * stripe, every cell is on a cache line of its own. A thread always updates
+ * the same cell, and a read sums all of them.
+ */
+template<typename T, std::size_t Stripes>
+class counter_cells
+{
+public:
+    constexpr counter_cells() noexcept : cells{} {}
+
+    constexpr counter_cells(T val) noexcept : cells{{val}} {}
+
+    bool is_lock_free() const volatile noexcept
+    {
+        return cells[0].value.is_lock_free();
+    }
+
+    void add(T val) const volatile noexcept
+    {
+        mine().value.fetch_add(val, std::memory_order_relaxed);
+    }
+
+    void sub(T val) const volatile noexcept
+    {
+        mine().value.fetch_sub(val, std::memory_order_relaxed);
+    }
+
+    T sum() const volatile noexcept
+    {
+        T total = 0;
+        for (auto const volatile& c : cells) {
+            total += c.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    std::atomic<unsigned> &enter() const noexcept
+    {
+        std::atomic<unsigned> &writers =
+            const_cast<std::atomic<unsigned> &>(mine().writers);
+        writers.fetch_add(1, std::memory_order_relaxed);
+        return writers;
+    }
+
+    void wait_quiescent() const volatile noexcept
+    {
+        for (auto const volatile& c : cells) {
+            spin_wait spin;
+            while (c.writers.load(std::memory_order_acquire) != 0) {
+                spin.wait();
+            }
+        }
+    }
+
+private:
+    typedef typename std::conditional<
+        Stripes == 1, counter_cell<T>, padded_counter_cell<T>>::type cell;
+
+    cell volatile &mine() const volatile noexcept
+    {
+        return cells[Stripes == 1 ? 0 : thread_index() % Stripes];
+    }
+
+    mutable cell cells[Stripes];
+};
+
+} // namespace _
+
+template<typename T, std::size_t Stripes = 1>
 /**
  * @brief An efficient atomic counter.
  *
@@ -18,23 +109,53 @@ template<typename T>
  * value of the variable. "Reader" threads will only
  * see a consistent view of the counter after all
  * writer threads are finished writing.
+ *
+ * With more than one stripe, the counter keeps
+ * that many cells, each on a cache line of its own.
+ * Every thread updates one cell, picked by
+ * sky::thread_index(), and reading the counter sums
+ * all cells. Writers on different cells do not
+ * contend, so increments scale with the number of
+ * cores, at the price of a larger counter and a
+ * read that costs one load per stripe.
+ *
+ * Writers may register for the duration of a batch
+ * of updates with an atomic_counter::writer. A
+ * reader then calls wait_quiescent() to wait until
+ * no registered writer is left, after which load()
+ * includes every update made by those writers.
+ * snapshot() returns the amount counted since a
+ * value the caller kept from its previous snapshot.
+ * It does not reset the counter, so readers taking
+ * deltas and readers of the total do not interfere.
+ *
+ * To support writer registration, the unstriped
+ * atomic_counter<T> also carries the number of its
+ * registered writers, next to its value, so it is
+ * larger than a plain std::atomic<T>.
+ *
+ * A striped counter is aligned to a cache line so
+ * that its stripes never share one. Before C++17,
+ * operator new does not honour that alignment, so
+ * striped counters are best kept in static storage
+ * or inside objects that are.
  */
 class atomic_counter
 {
     static_assert(std::is_integral<T>::value &&
                   !std::is_same<T, bool>::value,
                   "T must be a non-bool, integral type.");
+    static_assert(Stripes > 0, "A counter needs at least one stripe.");
 
 public:
 
+    class writer;
+
     /**
-     * @brief Creates an atomic counter.
-     *
-     * No initialization takes place other than
-     * zero initialization of static and thread-local
-     * objects.
+     * @brief Creates an atomic counter with a value
+     * of zero.
      */
-    atomic_counter() noexcept = default;
+    constexpr atomic_counter() noexcept = default;
 
     /**
      * @brief Creates an atomic counter with some
@@ -109,171 +230,272 @@ public:
      * @brief Access the value of the counter.
      * @return The value of the counter.
      */
-    T load() noexcept;
-    T load() volatile noexcept;
+    T load() const noexcept;
+    T load() const volatile noexcept;
     /// @}
 
     /// @{
     /**
      * @brief The value of the counter.
      */
-    operator T() noexcept;
-    operator T() volatile noexcept;
+    operator T() const noexcept;
+    operator T() const volatile noexcept;
+    /// @}
+
+    /// @{
+    /**
+     * @brief Waits until no writer is registered.
+     *
+     * Afterwards, load() includes every update made
+     * by writers that were registered before the call.
+     * Writers that register during the call may be
+     * waited for too, so this returns promptly only if
+     * writers register for bounded batches of work.
+     */
+    void wait_quiescent() const noexcept;
+    void wait_quiescent() const volatile noexcept;
+    /// @}
+
+    /// @{
+    /**
+     * @brief The amount counted since a previous
+     * snapshot.
+     *
+     * Every cell is read once, and a later read of a
+     * cell never sees an older value than an earlier
+     * one, so a series of snapshots through the same
+     * last value counts every update exactly once,
+     * even while writers keep counting.
+     *
+     * @param last The value of the counter at the
+     *        previous snapshot, or zero for the first
+     *        one. Assigned the current value.
+     * @return The current value minus last.
+     */
+    T snapshot(T &last) const noexcept;
+    T snapshot(T &last) const volatile noexcept;
     /// @}
 
 private:
-    mutable std::atomic<T> value;
+    _::counter_cells<T, Stripes> cells;
 };
 
-template<typename T>
+/**
+ * @brief Registers the calling thread as a writer of
+ * an atomic counter, for as long as it exists.
+ *
+ * Registration costs two atomic operations on the
+ * thread's own stripe, so a writer should cover a
+ * batch of updates rather than a single one.
+ */
+template<typename T, std::size_t Stripes>
+class atomic_counter<T, Stripes>::writer
+{
+public:
+    explicit writer(atomic_counter const& counter) noexcept :
+        writers(counter.cells.enter())
+    {}
+
+    writer(writer const&) = delete;
+    writer &operator =(writer const&) = delete;
+
+    ~writer()
+    {
+        // Publishes the writer's updates to wait_quiescent().
+        writers.fetch_sub(1, std::memory_order_release);
+    }
+
+private:
+    std::atomic<unsigned> &writers;
+};
+
+template<typename T, std::size_t Stripes>
 constexpr
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 atomic_counter(T val) noexcept :
-    value(val)
+    cells(val)
 {}
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 bool
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 is_lock_free() const noexcept
 {
-    return value.is_lock_free();
+    return cells.is_lock_free();
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 bool
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 is_lock_free() const volatile noexcept
 {
-    return value.is_lock_free();
+    return cells.is_lock_free();
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 void
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 operator ++() const noexcept
 {
     operator +=(T(1));
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 void
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 operator ++() const volatile noexcept
 {
     operator +=(T(1));
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 void
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 operator ++(int) const noexcept
 {
     operator +=(T(1));
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 void
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 operator ++(int) const volatile noexcept
 {
     operator +=(T(1));
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 void
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 operator +=(T val) const noexcept
 {
-    value.fetch_add(val, std::memory_order_relaxed);
+    cells.add(val);
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 void
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 operator +=(T val) const volatile noexcept
 {
-    value.fetch_add(val, std::memory_order_relaxed);
+    cells.add(val);
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 void
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 operator --() const noexcept
 {
     operator -=(T(1));
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 void
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 operator --() const volatile noexcept
 {
     operator -=(T(1));
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 void
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 operator --(int) const noexcept
 {
     operator -=(T(1));
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 void
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 operator --(int) const volatile noexcept
 {
     operator -=(T(1));
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 void
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 operator -=(T val) const noexcept
 {
-    value.fetch_sub(val, std::memory_order_relaxed);
+    cells.sub(val);
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 void
-atomic_counter<T>::
+atomic_counter<T, Stripes>::
 operator -=(T val) const volatile noexcept
 {
-    value.fetch_sub(val, std::memory_order_relaxed);
+    cells.sub(val);
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 T
-atomic_counter<T>::
-load() noexcept
+atomic_counter<T, Stripes>::
+load() const noexcept
 {
-    return value.load(std::memory_order_relaxed);
+    return cells.sum();
 }
 
-template<typename T>
+template<typename T, std::size_t Stripes>
 T
-atomic_counter<T>::
-load() volatile noexcept
+atomic_counter<T, Stripes>::
+load() const volatile noexcept
 {
-    return value.load(std::memory_order_relaxed);
+    return cells.sum();
 }
 
-template<typename T>
-atomic_counter<T>::
-operator T() noexcept
+template<typename T, std::size_t Stripes>
+atomic_counter<T, Stripes>::
+operator T() const noexcept
 {
     return load();
 }
 
-template<typename T>
-atomic_counter<T>::
-operator T() volatile noexcept
+template<typename T, std::size_t Stripes>
+atomic_counter<T, Stripes>::
+operator T() const volatile noexcept
 {
     return load();
 }
 
+template<typename T, std::size_t Stripes>
+void
+atomic_counter<T, Stripes>::
+wait_quiescent() const noexcept
+{
+    cells.wait_quiescent();
+}
+
+template<typename T, std::size_t Stripes>
+void
+atomic_counter<T, Stripes>::
+wait_quiescent() const volatile noexcept
+{
+    cells.wait_quiescent();
+}
+
+template<typename T, std::size_t Stripes>
+T
+atomic_counter<T, Stripes>::
+snapshot(T &last) const noexcept
+{
+    T current = cells.sum();
+    T delta = current - last;
+    last = current;
+    return delta;
+}
+
+template<typename T, std::size_t Stripes>
+T
+atomic_counter<T, Stripes>::
+snapshot(T &last) const volatile noexcept
+{
+    T current = cells.sum();
+    T delta = current - last;
+    last = current;
+    return delta;
+}
+
 } // namespace sky
 
 #endif // ATOMIC_HPP
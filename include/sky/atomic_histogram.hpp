@@ -0,0 +1,382 @@
+#ifndef ATOMIC_HISTOGRAM_HPP
+#define ATOMIC_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "sky/cpu.hpp"
+
+namespace sky {
+
+namespace _ {
+
+/*
+ * The log-linear bucket layout shared by atomic_histogram and
+ * histogram_snapshot. Values below 2^sub_bucket_bits have a bucket each.
+ * Above that, every power of two is split into 2^sub_bucket_bits buckets of
+ * equal width, so a bucket is never wider than 1/2^sub_bucket_bits of the
+ * values in it.
+ */
+struct histogram_layout
+{
+    static constexpr unsigned sub_bucket_bits = 5;
+    static constexpr std::size_t sub_buckets =
+        std::size_t(1) << sub_bucket_bits;
+    static constexpr std::size_t bucket_count =
+        (64 - sub_bucket_bits + 1) * sub_buckets;
+
+    static std::size_t index(std::uint64_t value) noexcept
+    {
+        if (value < sub_buckets) return std::size_t(value);
+        unsigned magnitude = 63 - __builtin_clzll(value);
+        unsigned shift = magnitude - sub_bucket_bits;
+        return sub_buckets * (shift + 1)
+            + std::size_t(value >> shift) - sub_buckets;
+    }
+
+    static std::uint64_t lowest(std::size_t index) noexcept
+    {
+        if (index < sub_buckets) return index;
+        unsigned shift = unsigned(index / sub_buckets) - 1;
+        std::uint64_t sub = index % sub_buckets;
+        return (sub_buckets + sub) << shift;
+    }
+
+    static std::uint64_t highest(std::size_t index) noexcept
+    {
+        if (index < sub_buckets) return index;
+        unsigned shift = unsigned(index / sub_buckets) - 1;
+        return lowest(index) + ((std::uint64_t(1) << shift) - 1);
+    }
+};
+
+} // namespace _
+
+/** @brief A snapshot of an atomic_histogram
+ *
+ * A snapshot is a plain, non-atomic copy of the bucket counts. Snapshots of
+ * different histograms, or of the same histogram at different times, can be
+ * merged, and queried for percentiles.
+ *
+ * Every value is reported as the highest value of its bucket, so results
+ * are never too low, and too high by at most 1/32 of the value.
+ */
+class histogram_snapshot
+{
+public:
+    histogram_snapshot();
+
+    /**
+     * @brief The number of recorded values.
+     */
+    std::uint64_t count() const noexcept;
+
+    /**
+     * @brief The value below or at which the given percentage of the recorded
+     * values lie.
+     * @param percent A percentage between 0 and 100.
+     * @return The value, or 0 if nothing was recorded.
+     */
+    std::uint64_t percentile(double percent) const noexcept;
+
+    /**
+     * @brief The smallest recorded value, or 0 if nothing was recorded.
+     */
+    std::uint64_t min() const noexcept;
+
+    /**
+     * @brief The largest recorded value, or 0 if nothing was recorded.
+     */
+    std::uint64_t max() const noexcept;
+
+    /**
+     * @brief The mean of the recorded values, or 0 if nothing was recorded.
+     */
+    double mean() const noexcept;
+
+    /**
+     * @brief Adds the values of another snapshot to this one.
+     */
+    histogram_snapshot &operator +=(histogram_snapshot const& other) noexcept;
+
+private:
+    template<std::size_t Stripes>
+    friend class atomic_histogram;
+
+    typedef _::histogram_layout layout;
+
+    std::vector<std::uint64_t> buckets;
+    std::uint64_t total;
+};
+
+/** @brief A concurrent histogram of unsigned integers, such as latencies
+ *
+ * Recording a value is a single relaxed increment of one bucket, with no
+ * locks and no compare-and-swap loop. The buckets are log-linear, as in an
+ * HDR histogram: values up to 31 are counted exactly, and above that every
+ * power of two is split into 32 buckets, which bounds the relative error to
+ * 1/32 over the whole range of std::uint64_t.
+ *
+ * With more than one stripe, the histogram keeps a set of buckets per
+ * stripe, and every thread records into the stripe picked by
+ * sky::thread_index(). Threads on different stripes then never write to the
+ * same cache line, at the price of 15 KiB per stripe.
+ *
+ * As with sky::atomic_counter, readers see a consistent view only after
+ * writers are done: load() and snapshot() read the buckets one at a time.
+ * Values recorded concurrently with snapshot() are counted either in that
+ * snapshot or in the next one, never in both and never in neither.
+ *
+ * The following operations are disabled:
+ *  - copying and moving
+ */
+template<std::size_t Stripes = 1>
+class atomic_histogram
+{
+    static_assert(Stripes > 0, "A histogram needs at least one stripe.");
+
+public:
+    typedef std::uint64_t value_type;
+
+    atomic_histogram();
+
+    atomic_histogram(atomic_histogram const&) = delete;
+    atomic_histogram &operator =(atomic_histogram const&) = delete;
+
+    /** @{
+     * @brief Records a value.
+     * @param value The value to record.
+     * @param n How many times to record it.
+     */
+    void record(value_type value) noexcept;
+    void record(value_type value, std::uint64_t n) noexcept;
+    /// @}
+
+    /**
+     * @brief Records a duration, in nanoseconds.
+     */
+    template<typename Rep, typename Period>
+    void record(std::chrono::duration<Rep, Period> const& d) noexcept;
+
+    /**
+     * @brief Copies the recorded values.
+     */
+    histogram_snapshot load() const;
+
+    /**
+     * @brief Copies the recorded values into an existing snapshot.
+     *
+     * Unlike load(), this never allocates, so it suits exporters that read
+     * the histogram periodically into the same snapshot.
+     *
+     * @param into Overwritten with the recorded values.
+     */
+    void load(histogram_snapshot &into) const noexcept;
+
+    /**
+     * @brief Takes the recorded values, and resets the histogram.
+     *
+     * Every bucket is exchanged with zero atomically, so every value is
+     * included in exactly one snapshot, even while writers keep recording.
+     */
+    histogram_snapshot snapshot();
+
+private:
+    typedef _::histogram_layout layout;
+    typedef std::atomic<std::uint64_t> bucket_type;
+
+    bucket_type *stripe() noexcept;
+
+    std::unique_ptr<bucket_type[]> buckets;
+};
+
+inline
+histogram_snapshot::
+histogram_snapshot() :
+    buckets(layout::bucket_count, 0),
+    total(0)
+{}
+
+inline
+std::uint64_t
+histogram_snapshot::
+count() const noexcept
+{
+    return total;
+}
+
+inline
+std::uint64_t
+histogram_snapshot::
+percentile(double percent) const noexcept
+{
+    if (total == 0) return 0;
+    if (percent < 0) percent = 0;
+    if (percent > 100) percent = 100;
+
+    /*
+     * The nearest rank, counting from 1. Dividing last keeps the product
+     * exact for whole percentages, so that ceil() does not round up an
+     * error such as 7.000000000000001.
+     */
+    std::uint64_t rank = std::uint64_t(std::ceil(percent * total / 100));
+    if (rank == 0) rank = 1;
+    if (rank > total) rank = total;
+
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < layout::bucket_count; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return layout::highest(i);
+    }
+    return max();
+}
+
+inline
+std::uint64_t
+histogram_snapshot::
+min() const noexcept
+{
+    for (std::size_t i = 0; i < layout::bucket_count; ++i) {
+        if (buckets[i]) return layout::highest(i);
+    }
+    return 0;
+}
+
+inline
+std::uint64_t
+histogram_snapshot::
+max() const noexcept
+{
+    for (std::size_t i = layout::bucket_count; i > 0; --i) {
+        if (buckets[i - 1]) return layout::highest(i - 1);
+    }
+    return 0;
+}
+
+inline
+double
+histogram_snapshot::
+mean() const noexcept
+{
+    if (total == 0) return 0;
+    double sum = 0;
+    for (std::size_t i = 0; i < layout::bucket_count; ++i) {
+        if (!buckets[i]) continue;
+        double mid = (double(layout::lowest(i)) + layout::highest(i)) / 2;
+        sum += mid * buckets[i];
+    }
+    return sum / total;
+}
+
+inline
+histogram_snapshot &
+histogram_snapshot::
+operator +=(histogram_snapshot const& other) noexcept
+{
+    for (std::size_t i = 0; i < layout::bucket_count; ++i) {
+        buckets[i] += other.buckets[i];
+    }
+    total += other.total;
+    return *this;
+}
+
+template<std::size_t Stripes>
+atomic_histogram<Stripes>::
+atomic_histogram() :
+    buckets(new bucket_type[Stripes * layout::bucket_count])
+{
+    for (std::size_t i = 0; i < Stripes * layout::bucket_count; ++i) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+template<std::size_t Stripes>
+void
+atomic_histogram<Stripes>::
+record(value_type value) noexcept
+{
+    stripe()[layout::index(value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+template<std::size_t Stripes>
+void
+atomic_histogram<Stripes>::
+record(value_type value, std::uint64_t n) noexcept
+{
+    stripe()[layout::index(value)].fetch_add(n, std::memory_order_relaxed);
+}
+
+template<std::size_t Stripes>
+template<typename Rep, typename Period>
+void
+atomic_histogram<Stripes>::
+record(std::chrono::duration<Rep, Period> const& d) noexcept
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    record(ns > 0 ? value_type(ns) : 0);
+}
+
+template<std::size_t Stripes>
+histogram_snapshot
+atomic_histogram<Stripes>::
+load() const
+{
+    histogram_snapshot s;
+    load(s);
+    return s;
+}
+
+template<std::size_t Stripes>
+void
+atomic_histogram<Stripes>::
+load(histogram_snapshot &into) const noexcept
+{
+    std::fill(into.buckets.begin(), into.buckets.end(), 0);
+    into.total = 0;
+    for (std::size_t st = 0; st < Stripes; ++st) {
+        bucket_type const *b = &buckets[st * layout::bucket_count];
+        for (std::size_t i = 0; i < layout::bucket_count; ++i) {
+            std::uint64_t n = b[i].load(std::memory_order_relaxed);
+            into.buckets[i] += n;
+            into.total += n;
+        }
+    }
+}
+
+template<std::size_t Stripes>
+histogram_snapshot
+atomic_histogram<Stripes>::
+snapshot()
+{
+    histogram_snapshot s;
+    for (std::size_t st = 0; st < Stripes; ++st) {
+        bucket_type *b = &buckets[st * layout::bucket_count];
+        for (std::size_t i = 0; i < layout::bucket_count; ++i) {
+            // Most buckets are empty, and loading is cheaper than exchanging.
+            if (b[i].load(std::memory_order_relaxed) == 0) continue;
+            std::uint64_t n = b[i].exchange(0, std::memory_order_relaxed);
+            s.buckets[i] += n;
+            s.total += n;
+        }
+    }
+    return s;
+}
+
+template<std::size_t Stripes>
+typename atomic_histogram<Stripes>::bucket_type *
+atomic_histogram<Stripes>::
+stripe() noexcept
+{
+    std::size_t st = Stripes == 1 ? 0 : thread_index() % Stripes;
+    return &buckets[st * layout::bucket_count];
+}
+
+} // namespace sky
+
+#endif // ATOMIC_HISTOGRAM_HPP
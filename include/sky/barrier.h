@@ -0,0 +1,85 @@
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <atomic>
+#include <functional>
+
+namespace sky {
+
+/**
+ * @brief A reusable barrier for a group of threads that work in phases.
+ *
+ * Every phase ends once each participating thread has arrived. The last
+ * thread to arrive runs the completion function, if there is one, and then
+ * releases all the others into the next phase. Threads can leave the group
+ * for good with arrive_and_drop().
+ *
+ * The barrier is sense-reversing: arriving is a single atomic decrement of
+ * the number of threads still to come, and the waiting threads watch a phase
+ * number that only the last thread changes. Waiting threads spin for a short
+ * while before they sleep, through sky::futex_wait(), and the last thread
+ * only calls the kernel if one of them did.
+ */
+class barrier
+{
+public:
+    /**
+     * @brief Identifies the phase a thread arrived in, for wait().
+     */
+    typedef int arrival_token;
+
+    /**
+     * @brief Creates a barrier.
+     * @param expected The number of participating threads, at least 1.
+     * @param completion Called by the last thread to arrive in every phase,
+     *        before any thread is released. It must not throw.
+     */
+    explicit barrier(int expected,
+                     std::function<void()> completion = nullptr);
+
+    barrier(barrier const&) = delete;
+    barrier &operator =(barrier const&) = delete;
+
+    /**
+     * @brief Arrives at the barrier, without waiting.
+     * @return A token to pass to wait().
+     */
+    arrival_token arrive();
+
+    /**
+     * @brief Waits until the phase the token was obtained in has ended.
+     * @param token The result of arrive() in the current or an earlier phase.
+     */
+    void wait(arrival_token token) const;
+
+    /**
+     * @brief Arrives at the barrier, and waits until every other participant
+     * has arrived too.
+     */
+    void arrive_and_wait();
+
+    /**
+     * @brief Arrives at the barrier, and leaves the group: later phases wait
+     * for one participant fewer.
+     */
+    void arrive_and_drop();
+
+private:
+    void complete_phase(arrival_token token);
+
+    // The participants still to arrive in the current phase.
+    std::atomic<int> remaining;
+    // The participants of the next phase.
+    std::atomic<int> participants;
+    /*
+     * The futex word: twice the phase number, plus one if a thread may be
+     * asleep, so that the last thread learns whether to wake anyone from the
+     * same exchange that ends the phase.
+     */
+    mutable std::atomic<int> phase;
+    std::function<void()> completion;
+};
+
+} // namespace sky
+
+#endif // BARRIER_H
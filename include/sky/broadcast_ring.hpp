@@ -0,0 +1,370 @@
+#ifndef BROADCAST_RING_HPP
+#define BROADCAST_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "sky/cpu.hpp"
+#include "sky/scope_guard.hpp"
+
+namespace sky {
+
+/** @brief A bounded, multi-producer ring buffer that delivers every element
+ * to every consumer
+ *
+ * This is a Disruptor-style ring: the slots are allocated and
+ * default-constructed once, up front, and producers publish an element by
+ * writing it into the next slot in place. Every consumer has its own cursor
+ * and reads each published element where it lies, so fanning one stream out
+ * to several consumers costs neither copies nor allocations.
+ *
+ * A producer claims a sequence number with a single fetch-and-add, fills the
+ * slot, and publishes it by stamping the slot with its sequence number.
+ * Consumers read runs of published slots and advance their cursor once per
+ * run. A slot is only reused once every consumer has moved past it, so the
+ * slowest consumer gates the producers: publish() waits for it, and
+ * try_publish() fails.
+ *
+ * The number of consumers is fixed at construction, and consumer i must only
+ * be driven by one thread at a time. Waiting producers and consumers
+ * busy-wait.
+ *
+ * #### Example
+ *
+ *     sky::broadcast_ring<event> ring(1024, 2);
+ *
+ *     // Producers
+ *     ring.publish(e);
+ *
+ *     // Consumer 0
+ *     ring.wait(0, [](event const& e) { log(e); });
+ *
+ *     // Consumer 1
+ *     ring.wait(1, [](event const& e) { count(e); });
+ */
+template<typename T>
+class broadcast_ring
+{
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef value_type &reference;
+    typedef value_type const& const_reference;
+
+    /**
+     * @brief Creates an empty ring.
+     *
+     * @param capacity The number of slots. It is rounded up to the next power
+     *        of two.
+     * @param consumers The number of consumers.
+     * @throws std::invalid_argument If there are no consumers.
+     */
+    broadcast_ring(size_type capacity, size_type consumers);
+
+    broadcast_ring(broadcast_ring const&) = delete;
+    broadcast_ring &operator =(broadcast_ring const&) = delete;
+
+    /**
+     * @brief The number of slots.
+     */
+    size_type capacity() const noexcept;
+
+    /**
+     * @brief The number of consumers.
+     */
+    size_type consumer_count() const noexcept;
+
+    /** @{
+     * @brief Publishes an element, waiting until the slowest consumer has
+     * made room for it.
+     */
+    void publish(T const& value);
+    void publish(T&& value);
+    /// @}
+
+    /** @{
+     * @brief Publishes an element unless the slowest consumer is a whole ring
+     * behind.
+     * @return true iff the element was published.
+     */
+    bool try_publish(T const& value);
+    bool try_publish(T&& value);
+    /// @}
+
+    /**
+     * @brief Publishes an element by filling a slot in place.
+     *
+     * Waits until the slowest consumer has made room. The slot still holds
+     * the element that was last published into it. The slot is published
+     * even if fill throws, since consumers cannot skip it.
+     *
+     * @param fill Called with a reference to the slot.
+     */
+    template<typename Fill>
+    void publish_with(Fill fill);
+
+    /**
+     * @brief Hands the published elements that a consumer has not seen yet to
+     * that consumer, without waiting.
+     *
+     * The cursor is advanced once for the whole run. If handler throws, the
+     * element it threw for is handed over again on the next call.
+     *
+     * @param consumer The consumer, from 0 to consumer_count() - 1.
+     * @param handler Called with a const reference to each element, in order.
+     * @param max_n The maximum number of elements to hand over.
+     * @return The number of elements handed over.
+     */
+    template<typename Handler>
+    size_type poll(size_type consumer, Handler handler,
+                   size_type max_n = std::numeric_limits<size_type>::max());
+
+    /**
+     * @brief Like poll(), but waits until there is at least one element.
+     */
+    template<typename Handler>
+    size_type wait(size_type consumer, Handler handler,
+                   size_type max_n = std::numeric_limits<size_type>::max());
+
+private:
+    typedef std::atomic<size_type> index_type;
+
+    struct cursor
+    {
+        index_type next;
+        char pad[cache_line_size - sizeof(index_type)];
+    };
+
+    bool try_claim(size_type &seq);
+
+    size_type claim();
+    void commit(size_type seq);
+
+    size_type slowest_consumer();
+
+    bool published(size_type seq) const;
+
+    std::unique_ptr<T[]> slots;
+    std::unique_ptr<index_type[]> stamps;
+    std::unique_ptr<cursor[]> cursors;
+    size_type mask;
+    size_type consumers;
+    char pad0[cache_line_size];
+    index_type claim_pos;
+    char pad1[cache_line_size - sizeof(index_type)];
+    // The position of the slowest consumer, as last seen by a producer.
+    index_type gate;
+    char pad2[cache_line_size - sizeof(index_type)];
+};
+
+template<typename T>
+broadcast_ring<T>::
+broadcast_ring(size_type capacity, size_type consumers) :
+    mask(0),
+    consumers(consumers),
+    claim_pos(0),
+    gate(0)
+{
+    if (consumers == 0) {
+        throw std::invalid_argument("broadcast_ring: No consumers.");
+    }
+    while (mask + 1 < capacity) mask = (mask << 1) | 1;
+    slots.reset(new T[mask + 1]);
+    stamps.reset(new index_type[mask + 1]);
+    cursors.reset(new cursor[consumers]);
+
+    /*
+     * A slot is stamped with its sequence number + 1 when it is published,
+     * so a fresh stamp of 0 never passes for a published slot.
+     */
+    for (size_type i = 0; i <= mask; ++i) {
+        stamps[i].store(0, std::memory_order_relaxed);
+    }
+    for (size_type i = 0; i < consumers; ++i) {
+        cursors[i].next.store(0, std::memory_order_relaxed);
+    }
+}
+
+template<typename T>
+typename broadcast_ring<T>::size_type
+broadcast_ring<T>::
+capacity() const noexcept
+{
+    return mask + 1;
+}
+
+template<typename T>
+typename broadcast_ring<T>::size_type
+broadcast_ring<T>::
+consumer_count() const noexcept
+{
+    return consumers;
+}
+
+template<typename T>
+void
+broadcast_ring<T>::
+publish(T const& value)
+{
+    publish_with([&value](T &slot) { slot = value; });
+}
+
+template<typename T>
+void
+broadcast_ring<T>::
+publish(T && value)
+{
+    publish_with([&value](T &slot) { slot = std::move(value); });
+}
+
+template<typename T>
+bool
+broadcast_ring<T>::
+try_publish(T const& value)
+{
+    size_type seq;
+    if (!try_claim(seq)) return false;
+    auto guard = scope_guard([this, seq] { commit(seq); });
+    slots[seq & mask] = value;
+    return true;
+}
+
+template<typename T>
+bool
+broadcast_ring<T>::
+try_publish(T && value)
+{
+    size_type seq;
+    if (!try_claim(seq)) return false;
+    auto guard = scope_guard([this, seq] { commit(seq); });
+    slots[seq & mask] = std::move(value);
+    return true;
+}
+
+template<typename T>
+template<typename Fill>
+void
+broadcast_ring<T>::
+publish_with(Fill fill)
+{
+    size_type seq = claim();
+    auto guard = scope_guard([this, seq] { commit(seq); });
+    fill(slots[seq & mask]);
+}
+
+template<typename T>
+template<typename Handler>
+typename broadcast_ring<T>::size_type
+broadcast_ring<T>::
+poll(size_type consumer, Handler handler, size_type max_n)
+{
+    index_type &next = cursors[consumer].next;
+    size_type begin = next.load(std::memory_order_relaxed);
+    size_type end = begin;
+    while (end - begin < max_n && published(end)) ++end;
+    if (end == begin) return 0;
+
+    size_type seq = begin;
+    auto guard = scope_guard([&next, &seq] {
+        next.store(seq, std::memory_order_release);
+    });
+    for (; seq != end; ++seq) {
+        handler(static_cast<T const&>(slots[seq & mask]));
+    }
+    return end - begin;
+}
+
+template<typename T>
+template<typename Handler>
+typename broadcast_ring<T>::size_type
+broadcast_ring<T>::
+wait(size_type consumer, Handler handler, size_type max_n)
+{
+    size_type seq = cursors[consumer].next.load(std::memory_order_relaxed);
+    spin_wait spin;
+    while (!published(seq)) spin.wait();
+    return poll(consumer, handler, max_n);
+}
+
+template<typename T>
+bool
+broadcast_ring<T>::
+try_claim(size_type &seq)
+{
+    seq = claim_pos.load(std::memory_order_relaxed);
+    for (;;) {
+        /*
+         * seq may be stale, and the consumers already past it, so the
+         * distances are signed: a negative one means that the CAS below
+         * fails and reloads seq, not that the ring is full.
+         */
+        if (static_cast<std::ptrdiff_t>(
+                    seq - gate.load(std::memory_order_acquire))
+                    > static_cast<std::ptrdiff_t>(mask)
+                && static_cast<std::ptrdiff_t>(seq - slowest_consumer())
+                    > static_cast<std::ptrdiff_t>(mask)) {
+            return false;
+        }
+        if (claim_pos.compare_exchange_weak(
+                    seq, seq + 1, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+template<typename T>
+typename broadcast_ring<T>::size_type
+broadcast_ring<T>::
+claim()
+{
+    size_type seq = claim_pos.fetch_add(1, std::memory_order_relaxed);
+
+    /*
+     * The slot for seq was last used for seq - capacity, so it is free once
+     * every consumer has moved past that. Scanning the cursors is costly, so
+     * the scan is only repeated when the cached gate says the ring is full.
+     */
+    if (seq - gate.load(std::memory_order_acquire) > mask) {
+        spin_wait spin;
+        while (seq - slowest_consumer() > mask) spin.wait();
+    }
+    return seq;
+}
+
+template<typename T>
+void
+broadcast_ring<T>::
+commit(size_type seq)
+{
+    stamps[seq & mask].store(seq + 1, std::memory_order_release);
+}
+
+template<typename T>
+typename broadcast_ring<T>::size_type
+broadcast_ring<T>::
+slowest_consumer()
+{
+    size_type min = cursors[0].next.load(std::memory_order_acquire);
+    for (size_type i = 1; i < consumers; ++i) {
+        size_type next = cursors[i].next.load(std::memory_order_acquire);
+        if (static_cast<std::ptrdiff_t>(next - min) < 0) min = next;
+    }
+    gate.store(min, std::memory_order_release);
+    return min;
+}
+
+template<typename T>
+bool
+broadcast_ring<T>::
+published(size_type seq) const
+{
+    return stamps[seq & mask].load(std::memory_order_acquire) == seq + 1;
+}
+
+} // namespace sky
+
+#endif // BROADCAST_RING_HPP
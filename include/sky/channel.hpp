@@ -0,0 +1,440 @@
+#ifndef CHANNEL_HPP
+#define CHANNEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "sky/concurrent_queue.hpp"
+#include "sky/scope_guard.hpp"
+
+namespace sky {
+
+/**
+ * @brief Returned by select_for() and select_until() when no channel became
+ * ready in time.
+ */
+constexpr std::size_t select_timeout = ~std::size_t(0);
+
+namespace _ {
+
+// A thread that is blocked in select().
+struct select_waiter
+{
+    select_waiter() : signalled(false) {}
+
+    void notify()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        signalled = true;
+        cv.notify_one();
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool signalled;
+};
+
+/*
+ * The part of a channel that select() needs: whether it is ready, and the
+ * list of selecting threads to notify when it becomes ready.
+ */
+class channel_base
+{
+public:
+    channel_base(channel_base const&) = delete;
+    channel_base &operator =(channel_base const&) = delete;
+
+    /**
+     * @brief Determines whether receiving from the channel would not block,
+     * because there is an element to receive or the channel is closed.
+     */
+    virtual bool ready() const = 0;
+
+    void attach(select_waiter *waiter)
+    {
+        std::lock_guard<std::mutex> lock(selector_mutex);
+        waiters.push_back(waiter);
+        selectors.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    void detach(select_waiter *waiter)
+    {
+        std::lock_guard<std::mutex> lock(selector_mutex);
+        waiters.erase(std::find(waiters.begin(), waiters.end(), waiter));
+        selectors.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+protected:
+    channel_base() : selectors(0) {}
+
+    ~channel_base() = default;
+
+    void notify_selectors()
+    {
+        /*
+         * Pairs with the fence in select_any(): either the selecting thread
+         * sees the channel ready, or we see it attached.
+         */
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (selectors.load(std::memory_order_relaxed) == 0) return;
+
+        std::lock_guard<std::mutex> lock(selector_mutex);
+        for (select_waiter *waiter : waiters) waiter->notify();
+    }
+
+private:
+    std::atomic<unsigned> selectors;
+    std::mutex selector_mutex;
+    std::vector<select_waiter *> waiters;
+};
+
+inline std::size_t first_ready(channel_base *const *channels, std::size_t n)
+{
+    /*
+     * Start at a different channel every time, so that a busy channel
+     * cannot starve the ones after it.
+     */
+    static thread_local std::size_t rotation = 0;
+    std::size_t start = rotation++ % n;
+    for (std::size_t i = 0; i < n; ++i) {
+        std::size_t index = (start + i) % n;
+        if (channels[index]->ready()) return index;
+    }
+    return select_timeout;
+}
+
+template<typename Wait>
+std::size_t select_any(channel_base *const *channels, std::size_t n,
+                       Wait wait)
+{
+    std::size_t index = first_ready(channels, n);
+    if (index != select_timeout) return index;
+
+    select_waiter waiter;
+    for (std::size_t i = 0; i < n; ++i) channels[i]->attach(&waiter);
+    auto detach = scope_guard([channels, n, &waiter] {
+        for (std::size_t i = 0; i < n; ++i) channels[i]->detach(&waiter);
+    });
+
+    for (;;) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        index = first_ready(channels, n);
+        if (index != select_timeout) return index;
+
+        std::unique_lock<std::mutex> lock(waiter.mutex);
+        while (!waiter.signalled) {
+            if (!wait(lock, waiter.cv)) {
+                lock.unlock();
+                return first_ready(channels, n);
+            }
+        }
+        waiter.signalled = false;
+    }
+}
+
+} // namespace _
+
+/** @brief A bounded, closeable multi-producer/multi-consumer channel that
+ * can be waited on together with other channels
+ *
+ * A channel is a sky::concurrent_queue that also notifies the threads that
+ * are blocked in select() on it. Sending never takes a lock unless a thread
+ * is selecting on the channel.
+ *
+ * send() waits while the channel is full, and receive() waits while it is
+ * empty. close() ends the stream: sending to a closed channel fails, but the
+ * elements already in it can still be received.
+ *
+ * The following operations are disabled:
+ *  - copying and moving
+ */
+template<typename T>
+class channel : public _::channel_base
+{
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef value_type &reference;
+    typedef value_type const& const_reference;
+
+    /**
+     * @brief Creates an empty, open channel.
+     * @param capacity The maximum number of elements in the channel, rounded
+     *        up as for sky::concurrent_queue.
+     */
+    explicit channel(size_type capacity = 1024);
+
+    /**
+     * @brief The maximum number of elements in the channel.
+     */
+    size_type capacity() const noexcept;
+
+    /** @{
+     * @brief Sends an element, waiting until there is room for it.
+     * @throws queue_closed If the channel is, or becomes, closed.
+     */
+    void send(T const& value);
+    void send(T&& value);
+    /// @}
+
+    /** @{
+     * @brief Sends an element unless the channel is full or closed.
+     * @return true iff the element was sent.
+     */
+    bool try_send(T const& value);
+    bool try_send(T&& value);
+    /// @}
+
+    /**
+     * @brief Receives an element, waiting until one is available.
+     * @throws queue_closed If the channel is closed and drained.
+     */
+    value_type receive();
+
+    /**
+     * @brief Receives an element, waiting until one is available.
+     * @param value Assigned the received element, if any.
+     * @return true iff an element was received; false iff the channel is
+     *         closed and drained.
+     */
+    bool receive(value_type &value);
+
+    /**
+     * @brief Receives an element, waiting for at most the given duration.
+     * @param value Assigned the received element, if any.
+     * @param timeout The maximum amount of time to wait.
+     * @return true iff an element was received.
+     */
+    template<typename Rep, typename Period>
+    bool receive_for(value_type &value,
+                     std::chrono::duration<Rep, Period> const& timeout);
+
+    /**
+     * @brief Receives an element unless the channel is empty.
+     * @param value Assigned the received element, if any.
+     * @return true iff an element was received.
+     */
+    bool try_receive(value_type &value);
+
+    /**
+     * @brief Closes the channel, and wakes every thread that is waiting on
+     * it, in select() or otherwise.
+     */
+    void close();
+
+    /**
+     * @brief Determines whether the channel is closed.
+     */
+    bool closed() const;
+
+    /**
+     * @brief Determines whether the channel is empty.
+     */
+    bool empty() const;
+
+    bool ready() const override;
+
+private:
+    concurrent_queue<T> queue;
+};
+
+/**
+ * @brief Waits until at least one of the given channels is ready.
+ *
+ * A channel is ready when there is an element to receive from it, or when
+ * it is closed. If several channels are ready, successive calls favour
+ * different ones, so that a busy channel cannot starve the others.
+ *
+ * Readiness is only a snapshot: when the channels have other consumers,
+ * they may empty the returned channel first. Receive from it with
+ * try_receive(), and select again if that fails.
+ *
+ * @param channels The channels to wait on, of any element types.
+ * @return The index of a ready channel, in the order of the arguments.
+ */
+template<typename... Channels>
+std::size_t select(Channels&... channels);
+
+/**
+ * @brief Waits until at least one of the given channels is ready, or until
+ * the timeout has passed.
+ * @return The index of a ready channel, or select_timeout.
+ */
+template<typename Rep, typename Period, typename... Channels>
+std::size_t select_for(std::chrono::duration<Rep, Period> const& timeout,
+                       Channels&... channels);
+
+/**
+ * @brief Waits until at least one of the given channels is ready, or until
+ * the deadline.
+ * @return The index of a ready channel, or select_timeout.
+ */
+template<typename Clock, typename Duration, typename... Channels>
+std::size_t select_until(
+        std::chrono::time_point<Clock, Duration> const& deadline,
+        Channels&... channels);
+
+template<typename T>
+channel<T>::
+channel(size_type capacity) :
+    queue(capacity)
+{}
+
+template<typename T>
+typename channel<T>::size_type
+channel<T>::
+capacity() const noexcept
+{
+    return queue.capacity();
+}
+
+template<typename T>
+void
+channel<T>::
+send(T const& value)
+{
+    queue.push(value);
+    notify_selectors();
+}
+
+template<typename T>
+void
+channel<T>::
+send(T && value)
+{
+    queue.push(std::move(value));
+    notify_selectors();
+}
+
+template<typename T>
+bool
+channel<T>::
+try_send(T const& value)
+{
+    if (!queue.try_push(value)) return false;
+    notify_selectors();
+    return true;
+}
+
+template<typename T>
+bool
+channel<T>::
+try_send(T && value)
+{
+    if (!queue.try_push(std::move(value))) return false;
+    notify_selectors();
+    return true;
+}
+
+template<typename T>
+typename channel<T>::value_type
+channel<T>::
+receive()
+{
+    return queue.wait_pop();
+}
+
+template<typename T>
+bool
+channel<T>::
+receive(value_type &value)
+{
+    return queue.wait_pop(value);
+}
+
+template<typename T>
+template<typename Rep, typename Period>
+bool
+channel<T>::
+receive_for(value_type &value,
+            std::chrono::duration<Rep, Period> const& timeout)
+{
+    return queue.wait_pop_for(value, timeout);
+}
+
+template<typename T>
+bool
+channel<T>::
+try_receive(value_type &value)
+{
+    return queue.try_pop(value);
+}
+
+template<typename T>
+void
+channel<T>::
+close()
+{
+    queue.close();
+    notify_selectors();
+}
+
+template<typename T>
+bool
+channel<T>::
+closed() const
+{
+    return queue.closed();
+}
+
+template<typename T>
+bool
+channel<T>::
+empty() const
+{
+    return queue.empty();
+}
+
+template<typename T>
+bool
+channel<T>::
+ready() const
+{
+    return !queue.empty() || queue.closed();
+}
+
+template<typename... Channels>
+std::size_t select(Channels&... channels)
+{
+    static_assert(sizeof...(Channels) > 0, "Nothing to select from.");
+    _::channel_base *list[] = {&channels...};
+    return _::select_any(list, sizeof...(Channels),
+            [](std::unique_lock<std::mutex> &lock,
+               std::condition_variable &cv) {
+                cv.wait(lock);
+                return true;
+            });
+}
+
+template<typename Rep, typename Period, typename... Channels>
+std::size_t select_for(std::chrono::duration<Rep, Period> const& timeout,
+                       Channels&... channels)
+{
+    return select_until(std::chrono::steady_clock::now() + timeout,
+                        channels...);
+}
+
+template<typename Clock, typename Duration, typename... Channels>
+std::size_t select_until(
+        std::chrono::time_point<Clock, Duration> const& deadline,
+        Channels&... channels)
+{
+    static_assert(sizeof...(Channels) > 0, "Nothing to select from.");
+    _::channel_base *list[] = {&channels...};
+    return _::select_any(list, sizeof...(Channels),
+            [&deadline](std::unique_lock<std::mutex> &lock,
+                        std::condition_variable &cv) {
+                return cv.wait_until(lock, deadline)
+                    == std::cv_status::no_timeout;
+            });
+}
+
+} // namespace sky
+
+#endif // CHANNEL_HPP
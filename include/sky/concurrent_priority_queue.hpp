@@ -0,0 +1,406 @@
+#ifndef CONCURRENT_PRIORITY_QUEUE_HPP
+#define CONCURRENT_PRIORITY_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <type_traits>
+#include <vector>
+
+#include "sky/cpu.hpp"
+
+namespace sky {
+
+namespace _ {
+
+/**
+ * @brief A fast, thread-local pseudo-random number generator (xorshift32).
+ *
+ * Good enough to spread threads over shards, and cheap enough to call on
+ * every operation. Not suitable for anything else.
+ */
+inline std::uint32_t thread_random() noexcept
+{
+    static thread_local std::uint32_t state = static_cast<std::uint32_t>(
+            std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+} // namespace _
+
+/** @brief A relaxed, sharded, multi-producer/multi-consumer priority queue
+ *
+ * This is a MultiQueue: the elements are spread over several binary heaps,
+ * each protected by its own mutex. push() adds an element to a randomly
+ * chosen heap. try_pop() looks at the tops of two randomly chosen heaps and
+ * pops the higher-priority one of the two. Threads only ever try_lock() a
+ * heap on the fast path, and simply pick another one when it is busy, so
+ * the queue scales with the number of threads instead of serialising them
+ * on a single lock.
+ *
+ * The price is that the order is relaxed: a pop returns one of the
+ * highest-priority elements in the queue with high probability, but not
+ * necessarily the very highest. With a single shard the queue is exact.
+ *
+ * try_pop() only fails when it finds every heap empty. pop() waits until
+ * there is an element in the queue; it spins briefly and then parks on a
+ * condition variable.
+ *
+ * @tparam T The type of the elements.
+ * @tparam Compare The ordering of the elements, as for std::priority_queue:
+ *         the greatest element has the highest priority.
+ */
+template<typename T, typename Compare = std::less<T>>
+class concurrent_priority_queue
+{
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef Compare value_compare;
+    typedef value_type &reference;
+    typedef value_type const& const_reference;
+
+    /**
+     * @brief Creates an empty queue.
+     *
+     * @param shards The number of heaps. If 0, twice the number of hardware
+     *        threads is used.
+     * @param comp The ordering of the elements.
+     */
+    explicit concurrent_priority_queue(size_type shards = 0,
+                                       Compare const& comp = Compare());
+
+    concurrent_priority_queue(concurrent_priority_queue const&) = delete;
+    concurrent_priority_queue &
+    operator =(concurrent_priority_queue const&) = delete;
+
+    /**
+     * @brief The number of heaps the elements are spread over.
+     */
+    size_type shard_count() const noexcept;
+
+    /** @{
+     * @brief Pushes an element.
+     */
+    void push(T const& value);
+    void push(T&& value);
+
+    template<typename... Args>
+    void emplace(Args&&... args);
+    /// @}
+
+    /**
+     * @brief Pops a high-priority element unless the queue is empty.
+     * @param value Assigned the popped element, if any.
+     * @return true iff an element was popped.
+     */
+    bool try_pop(value_type &value);
+
+    /**
+     * @brief Pops a high-priority element, waiting until one is available.
+     */
+    value_type pop();
+
+    /**
+     * @brief Determines whether the queue is empty.
+     *
+     * Other threads may change the queue at any time, so the result is only
+     * a snapshot.
+     */
+    bool empty() const;
+
+private:
+    struct shard
+    {
+        std::mutex mutex;
+        std::vector<T> heap;
+        // Mirrors heap.size(), so that empty heaps can be skipped unlocked.
+        std::atomic<size_type> size;
+        char pad[cache_line_size];
+
+        shard() : size(0) {}
+    };
+
+    /*
+     * The number of times push() tries to find an uncontended heap before
+     * it waits for one, and the number of times try_pop() samples two heaps
+     * before it falls back to visiting all of them.
+     */
+    static constexpr unsigned lock_attempts = 4;
+
+    shard &random_shard();
+
+    template<typename... Args>
+    void push_into(shard &s, Args&&... args);
+
+    bool try_lock_nonempty(shard &s, std::unique_lock<std::mutex> &lock);
+
+    template<typename Sink>
+    void take(shard &s, Sink sink);
+
+    template<typename Sink>
+    bool pop_sampled(Sink sink);
+
+    template<typename Sink>
+    bool pop_any(Sink sink);
+
+    template<typename Pop>
+    void pop_or_park(Pop pop);
+
+    void wake_consumer();
+
+    std::unique_ptr<shard[]> shards;
+    size_type count;
+    Compare comp;
+    char pad0[cache_line_size];
+    std::atomic<unsigned> parked_consumers;
+    char pad1[cache_line_size - sizeof(std::atomic<unsigned>)];
+    std::mutex park_mutex;
+    std::condition_variable not_empty;
+};
+
+template<typename T, typename Compare>
+concurrent_priority_queue<T, Compare>::
+concurrent_priority_queue(size_type shards, Compare const& comp) :
+    count(shards),
+    comp(comp),
+    parked_consumers(0)
+{
+    if (count == 0) count = 2 * std::thread::hardware_concurrency();
+    if (count == 0) count = 2;
+    this->shards.reset(new shard[count]);
+}
+
+template<typename T, typename Compare>
+typename concurrent_priority_queue<T, Compare>::size_type
+concurrent_priority_queue<T, Compare>::
+shard_count() const noexcept
+{
+    return count;
+}
+
+template<typename T, typename Compare>
+void
+concurrent_priority_queue<T, Compare>::
+push(T const& value)
+{
+    emplace(value);
+}
+
+template<typename T, typename Compare>
+void
+concurrent_priority_queue<T, Compare>::
+push(T && value)
+{
+    emplace(std::move(value));
+}
+
+template<typename T, typename Compare>
+template<typename... Args>
+void
+concurrent_priority_queue<T, Compare>::
+emplace(Args&&... args)
+{
+    for (unsigned attempt = 1; ; ++attempt) {
+        shard &s = random_shard();
+        std::unique_lock<std::mutex> lock(s.mutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            if (attempt < lock_attempts) continue;
+            lock.lock();
+        }
+        push_into(s, std::forward<Args>(args)...);
+        break;
+    }
+    wake_consumer();
+}
+
+template<typename T, typename Compare>
+bool
+concurrent_priority_queue<T, Compare>::
+try_pop(value_type &value)
+{
+    auto sink = [&value](T &&top) { value = std::move(top); };
+    return pop_sampled(sink) || pop_any(sink);
+}
+
+template<typename T, typename Compare>
+typename concurrent_priority_queue<T, Compare>::value_type
+concurrent_priority_queue<T, Compare>::
+pop()
+{
+    /*
+     * Elements are popped straight out of the heap into the return value,
+     * so T need not be default constructible.
+     */
+    typedef typename std::aligned_storage<
+        sizeof(T), std::alignment_of<T>::value>::type storage_type;
+    storage_type storage;
+    T *result = reinterpret_cast<T *>(&storage);
+
+    auto sink = [result](T &&top) { ::new (result) T(std::move(top)); };
+    pop_or_park([this, &sink] { return pop_sampled(sink) || pop_any(sink); });
+
+    value_type value(std::move(*result));
+    result->~T();
+    return value;
+}
+
+template<typename T, typename Compare>
+bool
+concurrent_priority_queue<T, Compare>::
+empty() const
+{
+    for (size_type i = 0; i < count; ++i) {
+        if (shards[i].size.load(std::memory_order_acquire) != 0) return false;
+    }
+    return true;
+}
+
+template<typename T, typename Compare>
+typename concurrent_priority_queue<T, Compare>::shard &
+concurrent_priority_queue<T, Compare>::
+random_shard()
+{
+    // Maps a 32-bit random number onto [0, count) without a division.
+    std::uint64_t r = _::thread_random();
+    return shards[(r * count) >> 32];
+}
+
+template<typename T, typename Compare>
+template<typename... Args>
+void
+concurrent_priority_queue<T, Compare>::
+push_into(shard &s, Args&&... args)
+{
+    s.heap.emplace_back(std::forward<Args>(args)...);
+    std::push_heap(s.heap.begin(), s.heap.end(), comp);
+    s.size.store(s.heap.size(), std::memory_order_relaxed);
+}
+
+template<typename T, typename Compare>
+bool
+concurrent_priority_queue<T, Compare>::
+try_lock_nonempty(shard &s, std::unique_lock<std::mutex> &lock)
+{
+    if (s.size.load(std::memory_order_relaxed) == 0) return false;
+    std::unique_lock<std::mutex> attempt(s.mutex, std::try_to_lock);
+    if (!attempt.owns_lock() || s.heap.empty()) return false;
+    lock = std::move(attempt);
+    return true;
+}
+
+template<typename T, typename Compare>
+template<typename Sink>
+void
+concurrent_priority_queue<T, Compare>::
+take(shard &s, Sink sink)
+{
+    std::pop_heap(s.heap.begin(), s.heap.end(), comp);
+    sink(std::move(s.heap.back()));
+    s.heap.pop_back();
+    s.size.store(s.heap.size(), std::memory_order_relaxed);
+}
+
+template<typename T, typename Compare>
+template<typename Sink>
+bool
+concurrent_priority_queue<T, Compare>::
+pop_sampled(Sink sink)
+{
+    for (unsigned attempt = 0; attempt < lock_attempts; ++attempt) {
+        shard *a = &random_shard();
+        shard *b = &random_shard();
+        std::unique_lock<std::mutex> lock_a, lock_b;
+        bool has_a = try_lock_nonempty(*a, lock_a);
+        bool has_b = b != a && try_lock_nonempty(*b, lock_b);
+
+        if (has_a && has_b && comp(a->heap.front(), b->heap.front())) {
+            has_a = false;
+        }
+        if (has_a) {
+            take(*a, sink);
+            return true;
+        }
+        if (has_b) {
+            take(*b, sink);
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename T, typename Compare>
+template<typename Sink>
+bool
+concurrent_priority_queue<T, Compare>::
+pop_any(Sink sink)
+{
+    /*
+     * Sampling found nothing, so the queue is nearly empty, or very busy.
+     * Visit every heap, starting at a random one so that consumers do not
+     * all pile onto the first heap, and wait for the lock of each non-empty
+     * heap.
+     */
+    size_type start = &random_shard() - shards.get();
+    for (size_type i = 0; i < count; ++i) {
+        shard &s = shards[(start + i) % count];
+        if (s.size.load(std::memory_order_relaxed) == 0) continue;
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.heap.empty()) continue;
+        take(s, sink);
+        return true;
+    }
+    return false;
+}
+
+template<typename T, typename Compare>
+template<typename Pop>
+void
+concurrent_priority_queue<T, Compare>::
+pop_or_park(Pop pop)
+{
+    spin_wait spin;
+    while (!spin.yielding()) {
+        if (pop()) return;
+        spin.wait();
+    }
+
+    /*
+     * Announce ourselves as parked before checking the heaps one last time.
+     * A producer updates the size of its heap before checking for parked
+     * consumers, and the fences on both sides guarantee that either the
+     * producer sees us, or we see its element.
+     */
+    std::unique_lock<std::mutex> lock(park_mutex);
+    parked_consumers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (!pop()) not_empty.wait(lock);
+    parked_consumers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template<typename T, typename Compare>
+void
+concurrent_priority_queue<T, Compare>::
+wake_consumer()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked_consumers.load(std::memory_order_relaxed) == 0) return;
+
+    { std::lock_guard<std::mutex> lock(park_mutex); }
+    not_empty.notify_one();
+}
+
+} // namespace sky
+
+#endif // CONCURRENT_PRIORITY_QUEUE_HPP
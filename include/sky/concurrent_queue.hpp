@@ -1,126 +1,1133 @@
 #ifndef CONCURRENT_QUEUE_HPP
 #define CONCURRENT_QUEUE_HPP
 
-#include <queue>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
 #include <utility>
 #include <type_traits>
 
+#include "sky/cpu.hpp"
+#include "sky/memory.hpp"
+#include "sky/queue_stats.hpp"
+#include "sky/scope_guard.hpp"
+
 namespace sky {
 
-/** @brief A thread-safe queue
+/** @brief Thrown when pushing to a closed queue, or popping from a closed
+ * queue that has been drained.
+ */
+class queue_closed : public std::runtime_error
+{
+public:
+    queue_closed() : std::runtime_error("Queue is closed.") {}
+};
+
+/** @brief A bounded, lock-free, multi-producer/multi-consumer queue
+ *
+ * The queue is a ring buffer with a fixed capacity that is chosen at
+ * construction. Every slot of the ring carries a sequence number which tells
+ * producers and consumers whether the slot is ready for them.
+ * A producer or consumer claims a slot with a single compare-and-swap on the
+ * tail or head index, so try_push() and try_pop() never take a lock.
+ * The head and tail indices are kept on separate cache lines so that
+ * producers and consumers do not contend with each other.
+ *
+ * push() and emplace() are blocking: they wait until there is room in the
+ * queue, so a full queue throttles its producers. pop() and the wait_pop()
+ * family wait until there is an element in the queue. A waiting producer or
+ * consumer spins briefly and then parks on a condition variable, so idle
+ * threads do not use any CPU. Every push or pop wakes at most one parked
+ * thread on the other side, and only takes the parking mutex when a thread is
+ * parked there.
  *
- * Currently, this class is simply a thread-safe wrapper around std::queue;
- * However, the following operations are disabled:
+ * close() ends the stream. Pushing to a closed queue fails, but the elements
+ * that are already in it can still be popped. Once a closed queue has been
+ * drained, the waiting pops report the end of the stream instead of waiting.
+ *
+ * push_range() and pop_into() move whole runs of elements with a single
+ * claim on the tail or head index. The elements of the ring are stored
+ * contiguously, apart from their sequence numbers, so a run of trivially
+ * copyable elements is transferred with at most two calls to memcpy.
+ *
+ * The Stats policy decides which statistics the queue keeps; see
+ * null_queue_stats, the default, which keeps none and costs nothing, and
+ * queue_stats, which tracks depth, high-water mark, blocking and the time
+ * elements spend in the queue. stats() returns a snapshot of them.
+ *
+ * The ring and its sequence numbers are obtained from the allocator once, at
+ * construction, and returned when the queue is destroyed; pushing and
+ * popping never allocate.
+ *
+ * Construction, destruction, moving and swapping are not thread-safe.
+ * A moved-from queue owns no ring: it may only be destroyed, assigned to or
+ * swapped with.
+ * The following operations are disabled:
  *  - copying
  *  - back()
  *  - size()
  */
-template<typename T>
+template<typename T, typename Stats = null_queue_stats,
+         typename Alloc = std::allocator<T>>
 class concurrent_queue
 {
-public:
-    typedef std::queue<T> container_type;
-    typedef typename container_type::value_type value_type;
-    typedef typename container_type::size_type size_type;
-    typedef typename container_type::reference reference;
-    typedef typename container_type::const_reference const_reference;
+    static_assert(std::is_nothrow_move_constructible<T>::value,
+                  "T must be nothrow move constructible.");
 
-    concurrent_queue();
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef value_type &reference;
+    typedef value_type const& const_reference;
+    typedef Stats stats_type;
+    typedef Alloc allocator_type;
 
-    template<typename Alloc>
-    explicit concurrent_queue(Alloc &&alloc);
+    /**
+     * @brief Creates an empty queue.
+     *
+     * @param capacity The maximum number of elements in the queue.
+     *        It is rounded up to the next power of two, and to at least 2.
+     * @param alloc The allocator, which is rebound to allocate the ring.
+     */
+    explicit concurrent_queue(size_type capacity = 1024,
+                              Alloc const& alloc = Alloc());
 
     concurrent_queue(concurrent_queue const&) = delete;
 
+    /**
+     * @brief Moves the ring of another queue into a new queue.
+     *
+     * The other queue is left without a ring, and may only be destroyed,
+     * assigned to or swapped with.
+     */
     concurrent_queue(concurrent_queue &&);
 
     concurrent_queue &operator =(concurrent_queue const&) = delete;
 
+    /**
+     * @brief Moves the ring of another queue into this queue.
+     *
+     * The other queue is left as by the move constructor.
+     */
     concurrent_queue &operator =(concurrent_queue &&);
 
+    ~concurrent_queue();
+
+    /**
+     * @brief The maximum number of elements in the queue.
+     */
+    size_type capacity() const noexcept;
+
+    /** @{
+     * @brief Pushes an element unless the queue is full or closed.
+     * @return true iff the element was pushed.
+     */
+    bool try_push(T const& value);
+    bool try_push(T&& value);
+
+    template<typename... Args>
+    bool try_emplace(Args&&... args);
+    /// @}
+
+    /**
+     * @brief Pops an element unless the queue is empty.
+     * @param value Assigned the popped element, if any.
+     * @return true iff an element was popped.
+     */
+    bool try_pop(value_type &value);
+
+    /**
+     * @brief Pops an element, waiting until one is available.
+     *
+     * Equivalent to wait_pop().
+     *
+     * @throws queue_closed If the queue is closed and drained.
+     */
     value_type pop();
 
+    /**
+     * @brief Pops an element, waiting until one is available.
+     * @throws queue_closed If the queue is closed and drained.
+     */
+    value_type wait_pop();
+
+    /**
+     * @brief Pops an element, waiting until one is available.
+     * @param value Assigned the popped element, if any.
+     * @return true iff an element was popped; false iff the queue is closed
+     *         and drained.
+     */
+    bool wait_pop(value_type &value);
+
+    /**
+     * @brief Pops an element, waiting for at most the given duration.
+     * @param value Assigned the popped element, if any.
+     * @param timeout The maximum amount of time to wait.
+     * @return true iff an element was popped. If false, closed() tells
+     *         whether the wait timed out or the stream ended.
+     */
+    template<typename Rep, typename Period>
+    bool wait_pop_for(value_type &value,
+                      std::chrono::duration<Rep, Period> const& timeout);
+
+    /**
+     * @brief Pops an element, waiting until at most the given time point.
+     * @param value Assigned the popped element, if any.
+     * @param deadline The time at which to stop waiting.
+     * @return true iff an element was popped. If false, closed() tells
+     *         whether the wait timed out or the stream ended.
+     */
+    template<typename Clock, typename Duration>
+    bool wait_pop_until(
+            value_type &value,
+            std::chrono::time_point<Clock, Duration> const& deadline);
+
+    /** @{
+     * @brief Pushes an element, waiting until there is room for it.
+     * @throws queue_closed If the queue is, or becomes, closed.
+     */
     void push(T const& value);
     void push(T&& value);
 
     template<typename... Args>
-    void emplace(Args... args);
+    void emplace(Args&&... args);
+    /// @}
+
+    /**
+     * @brief Pushes a range of elements, waiting until there is room for all
+     * of them.
+     *
+     * Elements are pushed in runs: each run is claimed with one atomic
+     * operation and then copied into the queue in bulk. If constructing a T
+     * from an element of the range may throw, the elements are pushed one at
+     * a time instead.
+     *
+     * If the queue becomes closed while waiting for room, the elements that
+     * were already pushed stay in the queue.
+     *
+     * @param first The beginning of the range.
+     * @param last The end of the range.
+     * @throws queue_closed If the queue is, or becomes, closed.
+     */
+    template<typename ForwardIt>
+    void push_range(ForwardIt first, ForwardIt last);
 
+    /**
+     * @brief Pops up to a given number of elements, without waiting.
+     *
+     * All the popped elements are claimed with one atomic operation and then
+     * moved out of the queue in bulk. If assigning through the output
+     * iterator throws, the popped elements that were not moved out yet are
+     * destroyed, so that their slots are freed, and the exception is
+     * propagated.
+     *
+     * @param out The output iterator to move the popped elements into.
+     * @param max_n The maximum number of elements to pop.
+     * @return The number of elements popped.
+     */
+    template<typename OutputIt>
+    size_type pop_into(OutputIt out, size_type max_n);
+
+    /**
+     * @brief Determines whether the queue is empty.
+     *
+     * Other threads may change the queue at any time, so the result is only
+     * a snapshot.
+     */
     bool empty() const;
 
-    void swap(concurrent_queue const& other);
+    /**
+     * @brief Closes the queue.
+     *
+     * No element can be pushed after the queue is closed. Producers waiting
+     * for room fail, and consumers waiting for an element keep waiting only
+     * while there are elements left to pop. Closing a closed queue has no
+     * effect.
+     */
+    void close();
+
+    /**
+     * @brief Determines whether the queue is closed.
+     */
+    bool closed() const;
+
+    /**
+     * @brief A snapshot of the statistics kept by the Stats policy.
+     *
+     * May be called from any thread, at any time.
+     */
+    typename Stats::snapshot_type stats() const;
+
+    allocator_type get_allocator() const;
+
+    void swap(concurrent_queue &other);
 
 private:
-    container_type queue;
-};
+    typedef std::atomic<size_type> index_type;
+    typedef typename std::aligned_storage<
+        sizeof(T), std::alignment_of<T>::value>::type storage_type;
+
+    /*
+     * Closing the queue sets the top bit of the tail index, which makes every
+     * later attempt to claim a slot for pushing fail.
+     */
+    static constexpr size_type closed_bit = ~(~size_type(0) >> 1);
+
+    static size_type mask_for(size_type capacity);
+
+    bool claim_push(size_type &pos);
+    void commit_push(size_type pos);
+
+    bool claim_pop(size_type &pos);
+    void commit_pop(size_type pos);
+
+    size_type claim_push_range(size_type &pos, size_type n);
+    size_type claim_pop_range(size_type &pos, size_type n);
+
+    void await_sequence(size_type pos, size_type seq);
+
+    template<typename ForwardIt>
+    void push_range(ForwardIt first, ForwardIt last, std::true_type);
+
+    template<typename ForwardIt>
+    void push_range(ForwardIt first, ForwardIt last, std::false_type);
+
+    template<typename ForwardIt>
+    ForwardIt copy_in(ForwardIt first, size_type pos, size_type n);
+
+    template<typename OutputIt>
+    OutputIt move_out(OutputIt out, size_type pos, size_type n,
+                      size_type &moved);
+
+    template<typename Pointer>
+    static Pointer copy_run(Pointer first, T *dest, size_type n,
+                            std::true_type);
+
+    template<typename ForwardIt>
+    static ForwardIt copy_run(ForwardIt first, T *dest, size_type n,
+                              std::false_type);
+
+    static T *move_run(T *src, T *out, size_type n, size_type &moved,
+                       std::true_type);
+
+    template<typename OutputIt>
+    static OutputIt move_run(T *src, OutputIt out, size_type n,
+                             size_type &moved, std::false_type);
 
-template<typename T>
-concurrent_queue<T>::
-concurrent_queue() {}
+    template<typename Claim, typename Stop, typename Blocked, typename Wait>
+    bool claim_or_park(Claim claim, Stop stop, Blocked blocked,
+                       std::atomic<unsigned> &parked, Wait wait);
+
+    bool claim_push_or_park(size_type &pos);
+
+    template<typename Wait>
+    bool claim_pop_or_park(size_type &pos, Wait wait);
+
+    bool drained() const;
+
+    template<typename... Args>
+    void construct(size_type pos, Args&&... args);
+
+    void take(size_type pos, value_type &value);
+
+    void record_push(size_type pos, size_type n);
+    void record_pop(size_type pos, size_type n);
+
+    void wake(std::atomic<unsigned> &parked, std::condition_variable &cv,
+              size_type count);
+
+    template<typename... Args>
+    bool try_construct(std::true_type, Args&&... args);
+
+    template<typename... Args>
+    bool try_construct(std::false_type, Args&&... args);
+
+    T *element(size_type pos);
+
+    allocator_unique_ptr<index_type, Alloc> sequences;
+    allocator_unique_ptr<storage_type, Alloc> buffer;
+    size_type mask;
+    char pad0[cache_line_size];
+    index_type enqueue_pos;
+    char pad1[cache_line_size - sizeof(index_type)];
+    index_type dequeue_pos;
+    char pad2[cache_line_size - sizeof(index_type)];
+    std::atomic<unsigned> parked_consumers;
+    char pad3[cache_line_size - sizeof(std::atomic<unsigned>)];
+    std::atomic<unsigned> parked_producers;
+    char pad4[cache_line_size - sizeof(std::atomic<unsigned>)];
+    std::mutex park_mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    Stats statistics;
+};
 
-template<typename T>
-template<typename Alloc>
-concurrent_queue<T>::
-concurrent_queue(Alloc &&alloc) :
-    queue(std::forward<Alloc>(alloc))
-{}
+template<typename T, typename Stats, typename Alloc>
+concurrent_queue<T, Stats, Alloc>::
+concurrent_queue(size_type capacity, Alloc const& alloc) :
+    sequences(allocate_unique<index_type>(alloc, mask_for(capacity) + 1)),
+    buffer(allocate_unique<storage_type>(alloc, mask_for(capacity) + 1)),
+    mask(mask_for(capacity)),
+    enqueue_pos(0),
+    dequeue_pos(0),
+    parked_consumers(0),
+    parked_producers(0),
+    statistics(mask + 1)
+{
+    for (size_type i = 0; i <= mask; ++i) {
+        sequences[i].store(i, std::memory_order_relaxed);
+    }
+}
 
-template<typename T>
-concurrent_queue<T>::
+template<typename T, typename Stats, typename Alloc>
+concurrent_queue<T, Stats, Alloc>::
 concurrent_queue(concurrent_queue &&other) :
-    queue(std::move(other.queue))
-{}
+    sequences(std::move(other.sequences)),
+    buffer(std::move(other.buffer)),
+    mask(other.mask),
+    enqueue_pos(other.enqueue_pos.load(std::memory_order_relaxed)),
+    dequeue_pos(other.dequeue_pos.load(std::memory_order_relaxed)),
+    parked_consumers(0),
+    parked_producers(0),
+    statistics(std::move(other.statistics))
+{
+    other.enqueue_pos.store(0, std::memory_order_relaxed);
+    other.dequeue_pos.store(0, std::memory_order_relaxed);
+}
 
-template<typename T>
-concurrent_queue<T> &
-concurrent_queue<T>::
+template<typename T, typename Stats, typename Alloc>
+concurrent_queue<T, Stats, Alloc> &
+concurrent_queue<T, Stats, Alloc>::
 operator =(concurrent_queue &&other)
 {
-    queue = std::move(other.queue);
+    concurrent_queue(std::move(other)).swap(*this);
     return *this;
 }
 
-template<typename T>
-typename concurrent_queue<T>::value_type
-concurrent_queue<T>::
+template<typename T, typename Stats, typename Alloc>
+concurrent_queue<T, Stats, Alloc>::
+~concurrent_queue()
+{
+    if (!buffer) return;
+    size_type pos = dequeue_pos.load(std::memory_order_relaxed);
+    size_type end = enqueue_pos.load(std::memory_order_relaxed) & ~closed_bit;
+    for (; pos != end; ++pos) element(pos)->~T();
+}
+
+template<typename T, typename Stats, typename Alloc>
+typename concurrent_queue<T, Stats, Alloc>::size_type
+concurrent_queue<T, Stats, Alloc>::
+capacity() const noexcept
+{
+    return mask + 1;
+}
+
+template<typename T, typename Stats, typename Alloc>
+bool
+concurrent_queue<T, Stats, Alloc>::
+try_push(T const& value)
+{
+    return try_emplace(value);
+}
+
+template<typename T, typename Stats, typename Alloc>
+bool
+concurrent_queue<T, Stats, Alloc>::
+try_push(T && value)
+{
+    return try_emplace(std::move(value));
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename... Args>
+bool
+concurrent_queue<T, Stats, Alloc>::
+try_emplace(Args&&... args)
+{
+    return try_construct(std::is_nothrow_constructible<T, Args...>(),
+                         std::forward<Args>(args)...);
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename... Args>
+bool
+concurrent_queue<T, Stats, Alloc>::
+try_construct(std::true_type, Args&&... args)
+{
+    size_type pos;
+    if (!claim_push(pos)) return false;
+    construct(pos, std::forward<Args>(args)...);
+    return true;
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename... Args>
+bool
+concurrent_queue<T, Stats, Alloc>::
+try_construct(std::false_type, Args&&... args)
+{
+    /*
+     * A claimed slot must always be published, so anything that may throw
+     * has to happen before the slot is claimed.
+     */
+    T value(std::forward<Args>(args)...);
+    return try_construct(std::true_type(), std::move(value));
+}
+
+template<typename T, typename Stats, typename Alloc>
+bool
+concurrent_queue<T, Stats, Alloc>::
+try_pop(value_type &value)
+{
+    size_type pos;
+    if (!claim_pop(pos)) return false;
+    take(pos, value);
+    return true;
+}
+
+template<typename T, typename Stats, typename Alloc>
+typename concurrent_queue<T, Stats, Alloc>::value_type
+concurrent_queue<T, Stats, Alloc>::
 pop()
 {
-    value_type value = queue.front();
-    queue.pop(); // Exception safe?
+    return wait_pop();
+}
+
+template<typename T, typename Stats, typename Alloc>
+typename concurrent_queue<T, Stats, Alloc>::value_type
+concurrent_queue<T, Stats, Alloc>::
+wait_pop()
+{
+    size_type pos;
+    bool claimed = claim_pop_or_park(pos,
+            [this](std::unique_lock<std::mutex> &lock) {
+                not_empty.wait(lock);
+                return true;
+            });
+    if (!claimed) throw queue_closed();
+    record_pop(pos, 1);
+    T *elem = element(pos);
+    value_type value(std::move(*elem));
+    elem->~T();
+    commit_pop(pos);
+    wake(parked_producers, not_full, 1);
     return value;
 }
 
-template<typename T>
+template<typename T, typename Stats, typename Alloc>
+bool
+concurrent_queue<T, Stats, Alloc>::
+wait_pop(value_type &value)
+{
+    size_type pos;
+    bool claimed = claim_pop_or_park(pos,
+            [this](std::unique_lock<std::mutex> &lock) {
+                not_empty.wait(lock);
+                return true;
+            });
+    if (!claimed) return false;
+    take(pos, value);
+    return true;
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename Rep, typename Period>
+bool
+concurrent_queue<T, Stats, Alloc>::
+wait_pop_for(value_type &value,
+             std::chrono::duration<Rep, Period> const& timeout)
+{
+    return wait_pop_until(value, std::chrono::steady_clock::now() + timeout);
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename Clock, typename Duration>
+bool
+concurrent_queue<T, Stats, Alloc>::
+wait_pop_until(value_type &value,
+               std::chrono::time_point<Clock, Duration> const& deadline)
+{
+    size_type pos;
+    bool claimed = claim_pop_or_park(pos,
+            [this, &deadline](std::unique_lock<std::mutex> &lock) {
+                return not_empty.wait_until(lock, deadline)
+                    == std::cv_status::no_timeout;
+            });
+    if (!claimed) return false;
+    take(pos, value);
+    return true;
+}
+
+template<typename T, typename Stats, typename Alloc>
 void
-concurrent_queue<T>::
+concurrent_queue<T, Stats, Alloc>::
 push(T const& value)
 {
-    queue.push(value);
+    emplace(value);
 }
 
-template<typename T>
+template<typename T, typename Stats, typename Alloc>
 void
-concurrent_queue<T>::
+concurrent_queue<T, Stats, Alloc>::
 push(T && value)
 {
-    queue.push(std::move(value));
+    emplace(std::move(value));
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename... Args>
+void
+concurrent_queue<T, Stats, Alloc>::
+emplace(Args&&... args)
+{
+    T value(std::forward<Args>(args)...);
+    size_type pos;
+    if (!claim_push_or_park(pos)) throw queue_closed();
+    construct(pos, std::move(value));
 }
 
-template<typename T>
+template<typename T, typename Stats, typename Alloc>
+template<typename ForwardIt>
+void
+concurrent_queue<T, Stats, Alloc>::
+push_range(ForwardIt first, ForwardIt last)
+{
+    typedef decltype(*first) reference_type;
+    push_range(first, last,
+               std::is_nothrow_constructible<T, reference_type>());
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename ForwardIt>
+void
+concurrent_queue<T, Stats, Alloc>::
+push_range(ForwardIt first, ForwardIt last, std::true_type)
+{
+    size_type remaining = std::distance(first, last);
+    while (remaining > 0) {
+        size_type pos;
+        size_type n;
+        bool claimed = claim_or_park(
+                [&] { return (n = claim_push_range(pos, remaining)) != 0; },
+                [this] { return closed(); },
+                [this] { statistics.producer_blocked(); },
+                parked_producers,
+                [this](std::unique_lock<std::mutex> &lock) {
+                    not_full.wait(lock);
+                    return true;
+                });
+        if (!claimed) throw queue_closed();
+
+        first = copy_in(first, pos, n);
+        record_push(pos, n);
+        for (size_type i = 0; i < n; ++i) commit_push(pos + i);
+        wake(parked_consumers, not_empty, n);
+        remaining -= n;
+    }
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename ForwardIt>
+void
+concurrent_queue<T, Stats, Alloc>::
+push_range(ForwardIt first, ForwardIt last, std::false_type)
+{
+    for (; first != last; ++first) push(*first);
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename OutputIt>
+typename concurrent_queue<T, Stats, Alloc>::size_type
+concurrent_queue<T, Stats, Alloc>::
+pop_into(OutputIt out, size_type max_n)
+{
+    if (max_n == 0) return 0;
+    size_type pos;
+    size_type n = claim_pop_range(pos, max_n);
+    if (n == 0) return 0;
+    record_pop(pos, n);
+
+    // The slots must be freed even if the output iterator throws.
+    size_type moved = 0;
+    auto commit = scope_guard([this, pos, n, &moved] {
+        for (size_type i = moved; i < n; ++i) element(pos + i)->~T();
+        for (size_type i = 0; i < n; ++i) commit_pop(pos + i);
+        wake(parked_producers, not_full, n);
+    });
+    move_out(out, pos, n, moved);
+    return n;
+}
+
+template<typename T, typename Stats, typename Alloc>
 bool
-concurrent_queue<T>::
+concurrent_queue<T, Stats, Alloc>::
 empty() const
 {
-    return queue.empty();
+    return dequeue_pos.load(std::memory_order_acquire)
+        >= (enqueue_pos.load(std::memory_order_acquire) & ~closed_bit);
+}
+
+template<typename T, typename Stats, typename Alloc>
+void
+concurrent_queue<T, Stats, Alloc>::
+close()
+{
+    enqueue_pos.fetch_or(closed_bit, std::memory_order_acq_rel);
+
+    // Every parked thread has to re-check the queue, on either side.
+    std::lock_guard<std::mutex> lock(park_mutex);
+    not_empty.notify_all();
+    not_full.notify_all();
+}
+
+template<typename T, typename Stats, typename Alloc>
+bool
+concurrent_queue<T, Stats, Alloc>::
+closed() const
+{
+    return (enqueue_pos.load(std::memory_order_acquire) & closed_bit) != 0;
 }
 
-template<typename T>
+template<typename T, typename Stats, typename Alloc>
+typename Stats::snapshot_type
+concurrent_queue<T, Stats, Alloc>::
+stats() const
+{
+    return statistics.snapshot();
+}
+
+template<typename T, typename Stats, typename Alloc>
+typename concurrent_queue<T, Stats, Alloc>::allocator_type
+concurrent_queue<T, Stats, Alloc>::
+get_allocator() const
+{
+    return allocator_type(buffer.get_deleter().get_allocator());
+}
+
+template<typename T, typename Stats, typename Alloc>
 void
-concurrent_queue<T>::
-swap(concurrent_queue const& other)
+concurrent_queue<T, Stats, Alloc>::
+swap(concurrent_queue &other)
 {
     using std::swap;
-    swap(queue, other.queue);
+    swap(sequences, other.sequences);
+    swap(buffer, other.buffer);
+    swap(mask, other.mask);
+    statistics.swap(other.statistics);
+
+    size_type pos = enqueue_pos.load(std::memory_order_relaxed);
+    enqueue_pos.store(other.enqueue_pos.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+    other.enqueue_pos.store(pos, std::memory_order_relaxed);
+
+    pos = dequeue_pos.load(std::memory_order_relaxed);
+    dequeue_pos.store(other.dequeue_pos.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+    other.dequeue_pos.store(pos, std::memory_order_relaxed);
+}
+
+template<typename T, typename Stats, typename Alloc>
+bool
+concurrent_queue<T, Stats, Alloc>::
+claim_push(size_type &pos)
+{
+    /*
+     * A slot is free for the producer at position pos when its sequence
+     * number equals pos. If it is still pos - capacity + 1, the consumer of
+     * the previous lap has not emptied it yet, and the queue is full.
+     */
+    pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+        if (pos & closed_bit) return false;
+        size_type seq = sequences[pos & mask].load(std::memory_order_acquire);
+        auto dif = static_cast<std::ptrdiff_t>(seq - pos);
+        if (dif == 0) {
+            if (enqueue_pos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                return true;
+            }
+        } else if (dif < 0) {
+            return false;
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename T, typename Stats, typename Alloc>
+void
+concurrent_queue<T, Stats, Alloc>::
+commit_push(size_type pos)
+{
+    sequences[pos & mask].store(pos + 1, std::memory_order_release);
+}
+
+template<typename T, typename Stats, typename Alloc>
+bool
+concurrent_queue<T, Stats, Alloc>::
+claim_pop(size_type &pos)
+{
+    /*
+     * A slot is full for the consumer at position pos when its sequence
+     * number equals pos + 1. If it is still pos, no producer has filled
+     * it yet, and the queue is empty.
+     */
+    pos = dequeue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+        size_type seq = sequences[pos & mask].load(std::memory_order_acquire);
+        auto dif = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+        if (dif == 0) {
+            if (dequeue_pos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                return true;
+            }
+        } else if (dif < 0) {
+            return false;
+        } else {
+            pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template<typename T, typename Stats, typename Alloc>
+void
+concurrent_queue<T, Stats, Alloc>::
+commit_pop(size_type pos)
+{
+    sequences[pos & mask].store(pos + mask + 1, std::memory_order_release);
+}
+
+template<typename T, typename Stats, typename Alloc>
+typename concurrent_queue<T, Stats, Alloc>::size_type
+concurrent_queue<T, Stats, Alloc>::
+claim_push_range(size_type &pos, size_type n)
+{
+    /*
+     * Every slot behind the head index has been claimed by a consumer, so
+     * it is either free already or will be freed shortly. That makes the
+     * distance between the two indices a safe bound on how many slots can
+     * be claimed at once.
+     */
+    pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+        if (pos & closed_bit) return 0;
+        size_type head = dequeue_pos.load(std::memory_order_acquire);
+        auto used = static_cast<std::ptrdiff_t>(pos - head);
+        if (used < 0) {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+            continue;
+        }
+        size_type room = capacity() - used;
+        if (room == 0) return 0;
+        if (n > room) n = room;
+        if (enqueue_pos.compare_exchange_weak(
+                    pos, pos + n, std::memory_order_relaxed)) {
+            for (size_type i = 0; i < n; ++i) {
+                await_sequence(pos + i, pos + i);
+            }
+            return n;
+        }
+    }
+}
+
+template<typename T, typename Stats, typename Alloc>
+typename concurrent_queue<T, Stats, Alloc>::size_type
+concurrent_queue<T, Stats, Alloc>::
+claim_pop_range(size_type &pos, size_type n)
+{
+    /*
+     * Every slot behind the tail index has been claimed by a producer, so
+     * it is either full already or will be filled shortly.
+     */
+    pos = dequeue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+        size_type tail = enqueue_pos.load(std::memory_order_acquire)
+                       & ~closed_bit;
+        auto available = static_cast<std::ptrdiff_t>(tail - pos);
+        if (available < 0) {
+            pos = dequeue_pos.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (available == 0) return 0;
+        if (n > size_type(available)) n = available;
+        if (dequeue_pos.compare_exchange_weak(
+                    pos, pos + n, std::memory_order_relaxed)) {
+            for (size_type i = 0; i < n; ++i) {
+                await_sequence(pos + i, pos + i + 1);
+            }
+            return n;
+        }
+    }
+}
+
+template<typename T, typename Stats, typename Alloc>
+void
+concurrent_queue<T, Stats, Alloc>::
+await_sequence(size_type pos, size_type seq)
+{
+    index_type &sequence = sequences[pos & mask];
+    spin_wait spin;
+    while (sequence.load(std::memory_order_acquire) != seq) spin.wait();
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename ForwardIt>
+ForwardIt
+concurrent_queue<T, Stats, Alloc>::
+copy_in(ForwardIt first, size_type pos, size_type n)
+{
+    typedef std::integral_constant<bool,
+            std::is_trivially_copyable<T>::value &&
+            std::is_convertible<ForwardIt, T const*>::value> bulk;
+
+    // The run wraps around the end of the ring at most once.
+    size_type begin = pos & mask;
+    size_type first_run = std::min(n, capacity() - begin);
+    first = copy_run(first, element(begin), first_run, bulk());
+    return copy_run(first, element(0), n - first_run, bulk());
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename OutputIt>
+OutputIt
+concurrent_queue<T, Stats, Alloc>::
+move_out(OutputIt out, size_type pos, size_type n, size_type &moved)
+{
+    typedef std::integral_constant<bool,
+            std::is_trivially_copyable<T>::value &&
+            std::is_same<OutputIt, T *>::value> bulk;
+
+    size_type begin = pos & mask;
+    size_type first_run = std::min(n, capacity() - begin);
+    out = move_run(element(begin), out, first_run, moved, bulk());
+    return move_run(element(0), out, n - first_run, moved, bulk());
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename Pointer>
+Pointer
+concurrent_queue<T, Stats, Alloc>::
+copy_run(Pointer first, T *dest, size_type n, std::true_type)
+{
+    if (n > 0) std::memcpy(dest, static_cast<T const*>(first), n * sizeof(T));
+    return first + n;
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename ForwardIt>
+ForwardIt
+concurrent_queue<T, Stats, Alloc>::
+copy_run(ForwardIt first, T *dest, size_type n, std::false_type)
+{
+    for (size_type i = 0; i < n; ++i, ++first) ::new (dest + i) T(*first);
+    return first;
+}
+
+template<typename T, typename Stats, typename Alloc>
+T *
+concurrent_queue<T, Stats, Alloc>::
+move_run(T *src, T *out, size_type n, size_type &moved, std::true_type)
+{
+    if (n > 0) std::memcpy(out, src, n * sizeof(T));
+    moved += n;
+    return out + n;
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename OutputIt>
+OutputIt
+concurrent_queue<T, Stats, Alloc>::
+move_run(T *src, OutputIt out, size_type n, size_type &moved,
+         std::false_type)
+{
+    for (size_type i = 0; i < n; ++i, ++out) {
+        *out = std::move(src[i]);
+        src[i].~T();
+        ++moved;
+    }
+    return out;
+}
+
+template<typename T, typename Stats, typename Alloc>
+typename concurrent_queue<T, Stats, Alloc>::size_type
+concurrent_queue<T, Stats, Alloc>::
+mask_for(size_type capacity)
+{
+    size_type mask = 1;
+    while (mask + 1 < capacity) mask = (mask << 1) | 1;
+    return mask;
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename Claim, typename Stop, typename Blocked, typename Wait>
+bool
+concurrent_queue<T, Stats, Alloc>::
+claim_or_park(Claim claim, Stop stop, Blocked blocked,
+              std::atomic<unsigned> &parked, Wait wait)
+{
+    if (claim()) return true;
+    if (stop()) return false;
+    blocked();
+
+    spin_wait spin;
+    while (!spin.yielding()) {
+        spin.wait();
+        if (claim()) return true;
+        if (stop()) return false;
+    }
+
+    /*
+     * Announce ourselves as parked before checking the queue one last time.
+     * The other side updates the queue before checking for parked threads,
+     * and the fences on both sides guarantee that either it sees us, or we
+     * see its update. close() notifies under the mutex, so the stop condition
+     * cannot be missed either.
+     */
+    bool claimed;
+    std::unique_lock<std::mutex> lock(park_mutex);
+    parked.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (!(claimed = claim()) && !stop()) {
+        if (!wait(lock)) {
+            claimed = claim();
+            break;
+        }
+    }
+    parked.fetch_sub(1, std::memory_order_relaxed);
+    return claimed;
+}
+
+template<typename T, typename Stats, typename Alloc>
+bool
+concurrent_queue<T, Stats, Alloc>::
+claim_push_or_park(size_type &pos)
+{
+    return claim_or_park(
+            [this, &pos] { return claim_push(pos); },
+            [this] { return closed(); },
+            [this] { statistics.producer_blocked(); },
+            parked_producers,
+            [this](std::unique_lock<std::mutex> &lock) {
+                not_full.wait(lock);
+                return true;
+            });
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename Wait>
+bool
+concurrent_queue<T, Stats, Alloc>::
+claim_pop_or_park(size_type &pos, Wait wait)
+{
+    return claim_or_park(
+            [this, &pos] { return claim_pop(pos); },
+            [this] { return drained(); },
+            [this] { statistics.consumer_blocked(); },
+            parked_consumers,
+            wait);
+}
+
+template<typename T, typename Stats, typename Alloc>
+bool
+concurrent_queue<T, Stats, Alloc>::
+drained() const
+{
+    /*
+     * Every slot behind the tail index of a closed queue has been claimed by
+     * a producer, so once the head index catches up with it, no element is
+     * left and none can arrive.
+     */
+    size_type tail = enqueue_pos.load(std::memory_order_acquire);
+    return (tail & closed_bit)
+        && dequeue_pos.load(std::memory_order_acquire) == (tail & ~closed_bit);
+}
+
+template<typename T, typename Stats, typename Alloc>
+template<typename... Args>
+void
+concurrent_queue<T, Stats, Alloc>::
+construct(size_type pos, Args&&... args)
+{
+    ::new (element(pos)) T(std::forward<Args>(args)...);
+    record_push(pos, 1);
+    commit_push(pos);
+    wake(parked_consumers, not_empty, 1);
+}
+
+template<typename T, typename Stats, typename Alloc>
+void
+concurrent_queue<T, Stats, Alloc>::
+take(size_type pos, value_type &value)
+{
+    record_pop(pos, 1);
+    T *elem = element(pos);
+
+    // The slot must be freed even if the move assignment throws.
+    auto commit = scope_guard([this, pos, elem] {
+        elem->~T();
+        commit_pop(pos);
+        wake(parked_producers, not_full, 1);
+    });
+    value = std::move(*elem);
+}
+
+template<typename T, typename Stats, typename Alloc>
+void
+concurrent_queue<T, Stats, Alloc>::
+record_push(size_type pos, size_type n)
+{
+    // The depth costs a load of the head index, so only pay when it is used.
+    if (!Stats::enabled) return;
+    auto depth = static_cast<std::ptrdiff_t>(
+            pos + n - dequeue_pos.load(std::memory_order_relaxed));
+    if (depth < 0) depth = 0;
+    statistics.pushed(pos, n, std::min(size_type(depth), capacity()));
+}
+
+template<typename T, typename Stats, typename Alloc>
+void
+concurrent_queue<T, Stats, Alloc>::
+record_pop(size_type pos, size_type n)
+{
+    statistics.popped(pos, n);
+}
+
+template<typename T, typename Stats, typename Alloc>
+void
+concurrent_queue<T, Stats, Alloc>::
+wake(std::atomic<unsigned> &parked, std::condition_variable &cv,
+     size_type count)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked.load(std::memory_order_relaxed) == 0) return;
+
+    /*
+     * Taking the mutex ensures that a thread which has announced itself
+     * is either already waiting on the condition variable or has yet to
+     * check the queue again.
+     */
+    { std::lock_guard<std::mutex> lock(park_mutex); }
+    if (count == 1) {
+        cv.notify_one();
+    } else {
+        cv.notify_all();
+    }
+}
+
+template<typename T, typename Stats, typename Alloc>
+T *
+concurrent_queue<T, Stats, Alloc>::
+element(size_type pos)
+{
+    return reinterpret_cast<T *>(&buffer[pos & mask]);
 }
 
 } // namespace sky
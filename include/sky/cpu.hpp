@@ -0,0 +1,121 @@
+#ifndef CPU_HPP
+#define CPU_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+namespace sky {
+
+/**
+ * @brief The assumed size of a cache line, in bytes.
+ *
+ * Data that is written by different threads should be kept at least this far
+ * apart to avoid false sharing.
+ */
+constexpr std::size_t cache_line_size = 64;
+
+/**
+ * @brief Hints to the processor that the caller is busy-waiting.
+ *
+ * On x86 this is the `pause` instruction, which reduces the cost of the spin
+ * for the sibling hyper-thread and avoids a memory-order mis-speculation when
+ * the awaited value finally changes.
+ */
+inline void cpu_relax() noexcept
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+/**
+ * @brief A helper for busy-wait loops.
+ *
+ * The first few calls to wait() spin on the processor, after which the
+ * calling thread yields its time slice on every call.
+ *
+ * #### Example
+ *
+ *     sky::spin_wait spin;
+ *     while (!ready.load(std::memory_order_acquire)) spin.wait();
+ */
+class spin_wait
+{
+public:
+    /**
+     * @brief The number of calls to wait() that spin before yielding.
+     */
+    static constexpr unsigned spin_limit = 64;
+
+    /**
+     * @brief Waits a little while.
+     */
+    void wait() noexcept
+    {
+        if (count < spin_limit) {
+            ++count;
+            cpu_relax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+     * @brief Determines whether the next call to wait() will yield.
+     * @return true iff this spin_wait has exhausted its spins.
+     */
+    bool yielding() const noexcept
+    {
+        return count >= spin_limit;
+    }
+
+    /**
+     * @brief Starts spinning again from the beginning.
+     */
+    void reset() noexcept
+    {
+        count = 0;
+    }
+
+private:
+    unsigned count = 0;
+};
+
+/**
+ * @brief A small, dense identifier for the calling thread.
+ *
+ * Threads are numbered 0, 1, 2, ... in the order in which they first call
+ * this function, which makes the index suitable for picking a per-thread
+ * shard with a modulo. Indices are not reused when threads exit.
+ */
+inline unsigned thread_index() noexcept
+{
+    static std::atomic<unsigned> next(0);
+    static thread_local unsigned index =
+        next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+namespace _ {
+
+/**
+ * @brief Hands out a unique identifier for every queue, or other shared
+ * structure that threads keep a thread-local cache of.
+ *
+ * Identifiers are never reused, so a thread-local cache keyed by identifier
+ * can never refer to a structure that has since been destroyed.
+ */
+inline unsigned long next_domain_id()
+{
+    static std::atomic<unsigned long> id(0);
+    return id.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+} // namespace _
+
+} // namespace sky
+
+#endif // CPU_HPP
@@ -0,0 +1,266 @@
+#ifndef DELAY_QUEUE_HPP
+#define DELAY_QUEUE_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "sky/timer.h"
+
+namespace sky {
+
+/** @brief A multi-producer/multi-consumer queue of elements that only become
+ * poppable at a deadline
+ *
+ * Every element is pushed with a deadline on the steady clock of sky::timer,
+ * and elements are popped in order of their deadlines. Elements with equal
+ * deadlines are popped in the order in which they were pushed.
+ *
+ * The pending elements are kept in a binary heap behind a mutex, so push()
+ * and pop() cost O(log n) however many elements are pending. A blocking pop()
+ * sleeps on a condition variable until the earliest deadline, and is only
+ * woken early when a push brings the earliest deadline forward. Nothing
+ * polls.
+ */
+template<typename T>
+class delay_queue
+{
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef value_type &reference;
+    typedef value_type const& const_reference;
+
+    typedef timer::clock clock;
+    typedef timer::time_point time_point;
+    typedef timer::duration duration;
+
+    delay_queue();
+
+    delay_queue(delay_queue const&) = delete;
+    delay_queue &operator =(delay_queue const&) = delete;
+
+    /** @{
+     * @brief Pushes an element that becomes poppable at the given deadline.
+     */
+    void push(T const& value, time_point deadline);
+    void push(T&& value, time_point deadline);
+
+    template<typename... Args>
+    void emplace(time_point deadline, Args&&... args);
+    /// @}
+
+    /**
+     * @brief Pops the element with the earliest deadline, if it is due.
+     * @param value Assigned the popped element, if any.
+     * @return true iff an element was popped.
+     */
+    bool try_pop(value_type &value);
+
+    /**
+     * @brief Pops the element with the earliest deadline, waiting until it is
+     * due.
+     */
+    value_type pop();
+
+    /**
+     * @brief Pops the element with the earliest deadline, waiting until it is
+     * due or until the given time point, whichever comes first.
+     * @param value Assigned the popped element, if any.
+     * @param until The time at which to stop waiting.
+     * @return true iff an element was popped.
+     */
+    bool pop_until(value_type &value, time_point until);
+
+    /**
+     * @brief The number of pending elements, whether due or not.
+     */
+    size_type size() const;
+
+    /**
+     * @brief Determines whether there are no pending elements.
+     */
+    bool empty() const;
+
+private:
+    struct entry
+    {
+        time_point deadline;
+        std::uint64_t seq;
+        T value;
+    };
+
+    // Orders the heap so that the earliest deadline is on top.
+    struct later
+    {
+        bool operator ()(entry const& a, entry const& b) const
+        {
+            if (a.deadline != b.deadline) return a.deadline > b.deadline;
+            return a.seq > b.seq;
+        }
+    };
+
+    template<typename Wait>
+    bool wait_due(std::unique_lock<std::mutex> &lock, Wait wait);
+
+    T take();
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<entry> heap;
+    std::uint64_t next_seq;
+};
+
+template<typename T>
+delay_queue<T>::
+delay_queue() :
+    next_seq(0)
+{}
+
+template<typename T>
+void
+delay_queue<T>::
+push(T const& value, time_point deadline)
+{
+    emplace(deadline, value);
+}
+
+template<typename T>
+void
+delay_queue<T>::
+push(T && value, time_point deadline)
+{
+    emplace(deadline, std::move(value));
+}
+
+template<typename T>
+template<typename... Args>
+void
+delay_queue<T>::
+emplace(time_point deadline, Args&&... args)
+{
+    bool earliest;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        heap.push_back(entry{deadline, next_seq++,
+                             T(std::forward<Args>(args)...)});
+        std::push_heap(heap.begin(), heap.end(), later());
+        earliest = heap.front().seq == next_seq - 1;
+    }
+
+    // Only a new earliest deadline changes how long consumers should sleep.
+    if (earliest) changed.notify_one();
+}
+
+template<typename T>
+bool
+delay_queue<T>::
+try_pop(value_type &value)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (heap.empty() || heap.front().deadline > clock::now()) return false;
+    value = take();
+    return true;
+}
+
+template<typename T>
+typename delay_queue<T>::value_type
+delay_queue<T>::
+pop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    wait_due(lock, [this](std::unique_lock<std::mutex> &lock) {
+        if (heap.empty()) {
+            changed.wait(lock);
+        } else {
+            // A copy, since the heap may change while we wait.
+            time_point deadline = heap.front().deadline;
+            changed.wait_until(lock, deadline);
+        }
+        return true;
+    });
+    return take();
+}
+
+template<typename T>
+bool
+delay_queue<T>::
+pop_until(value_type &value, time_point until)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    bool due = wait_due(lock,
+            [this, until](std::unique_lock<std::mutex> &lock) {
+                if (clock::now() >= until) {
+                    /*
+                     * We may have taken the only wakeup for the earliest
+                     * deadline. Pass it on to a consumer that stays.
+                     */
+                    if (!heap.empty()) changed.notify_one();
+                    return false;
+                }
+                time_point deadline = until;
+                if (!heap.empty() && heap.front().deadline < deadline) {
+                    deadline = heap.front().deadline;
+                }
+                changed.wait_until(lock, deadline);
+                return true;
+            });
+    if (!due) return false;
+    value = take();
+    return true;
+}
+
+template<typename T>
+typename delay_queue<T>::size_type
+delay_queue<T>::
+size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return heap.size();
+}
+
+template<typename T>
+bool
+delay_queue<T>::
+empty() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return heap.empty();
+}
+
+template<typename T>
+template<typename Wait>
+bool
+delay_queue<T>::
+wait_due(std::unique_lock<std::mutex> &lock, Wait wait)
+{
+    while (heap.empty() || heap.front().deadline > clock::now()) {
+        if (!wait(lock)) return false;
+    }
+    return true;
+}
+
+template<typename T>
+T
+delay_queue<T>::
+take()
+{
+    std::pop_heap(heap.begin(), heap.end(), later());
+    T value(std::move(heap.back().value));
+    heap.pop_back();
+
+    /*
+     * Another consumer may be sleeping without a deadline, or until the
+     * deadline that was just popped. Pass the earliest deadline on to it.
+     */
+    if (!heap.empty()) changed.notify_one();
+    return value;
+}
+
+} // namespace sky
+
+#endif // DELAY_QUEUE_HPP
@@ -0,0 +1,466 @@
+#ifndef FLAT_COMBINING_QUEUE_HPP
+#define FLAT_COMBINING_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include "sky/cpu.hpp"
+#include "sky/scope_guard.hpp"
+
+namespace sky {
+
+/** @brief A bounded, flat-combining, multi-producer/multi-consumer queue
+ *
+ * Instead of having every thread fight over the head and tail of the queue,
+ * a thread publishes its push or pop as a request in a publication record
+ * of its own, and then tries to become the combiner by taking a single
+ * lock. The combiner walks all the records and applies every pending
+ * request to a plain, sequential ring buffer, while the other threads spin
+ * on their own record until their request has been answered. Records are
+ * allocated the first time a thread uses the queue, and are only freed when
+ * the queue is destroyed.
+ *
+ * Under heavy contention this keeps the ring buffer in the cache of one
+ * core at a time, and replaces a storm of failed compare-and-swaps with one
+ * lock hand-off per batch. Under light contention every operation pays for
+ * the publication round-trip, so concurrent_queue is the better choice there.
+ *
+ * push(), emplace() and pop() busy-wait until there is room in the queue, or
+ * an element in the queue, respectively.
+ *
+ * The following operations are disabled:
+ *  - copying and moving
+ *  - back()
+ *  - size()
+ */
+template<typename T>
+class flat_combining_queue
+{
+    static_assert(std::is_nothrow_move_constructible<T>::value,
+                  "T must be nothrow move constructible.");
+
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef value_type &reference;
+    typedef value_type const& const_reference;
+
+    /**
+     * @brief Creates an empty queue.
+     *
+     * @param capacity The maximum number of elements in the queue.
+     *        It is rounded up to the next power of two, and to at least 2.
+     */
+    explicit flat_combining_queue(size_type capacity = 1024);
+
+    flat_combining_queue(flat_combining_queue const&) = delete;
+    flat_combining_queue &operator =(flat_combining_queue const&) = delete;
+
+    ~flat_combining_queue();
+
+    /**
+     * @brief The maximum number of elements in the queue.
+     */
+    size_type capacity() const noexcept;
+
+    /** @{
+     * @brief Pushes an element unless the queue is full.
+     * @return true iff the element was pushed.
+     */
+    bool try_push(T const& value);
+    bool try_push(T&& value);
+
+    template<typename... Args>
+    bool try_emplace(Args&&... args);
+    /// @}
+
+    /**
+     * @brief Pops an element unless the queue is empty.
+     * @param value Assigned the popped element, if any.
+     * @return true iff an element was popped.
+     */
+    bool try_pop(value_type &value);
+
+    /**
+     * @brief Pops an element, waiting until one is available.
+     */
+    value_type pop();
+
+    /** @{
+     * @brief Pushes an element, waiting until there is room for it.
+     */
+    void push(T const& value);
+    void push(T&& value);
+
+    template<typename... Args>
+    void emplace(Args&&... args);
+    /// @}
+
+    /**
+     * @brief Determines whether the queue is empty.
+     *
+     * Other threads may change the queue at any time, so the result is only
+     * a snapshot.
+     */
+    bool empty() const;
+
+private:
+    typedef typename std::aligned_storage<
+        sizeof(T), std::alignment_of<T>::value>::type storage_type;
+
+    enum request_state : unsigned
+    {
+        idle,
+        push_request,
+        pop_request,
+        succeeded,
+        failed
+    };
+
+    struct record
+    {
+        std::atomic<bool> owned;
+        std::atomic<unsigned> state;
+        // The element to push, owned by the requesting thread.
+        T *source;
+        // The popped element, constructed by the combiner.
+        storage_type result;
+        record *next;
+        char pad[cache_line_size];
+
+        record() : owned(true), state(idle), source(nullptr), next(nullptr) {}
+
+        T *popped()
+        {
+            return reinterpret_cast<T *>(&result);
+        }
+    };
+
+    /*
+     * The maximum number of passes the combiner makes over the records, so
+     * that requests that arrive while it combines are served in the same
+     * batch.
+     */
+    static constexpr unsigned combine_passes = 3;
+
+    record &acquire_record();
+    record &find_record();
+    void release_record(record &r);
+
+    bool submit(record &r, request_state request);
+    void combine();
+
+    bool apply_push(T &source);
+    bool apply_pop(T *dest);
+
+    T *element(size_type pos);
+
+    // Only accessed by the combiner.
+    std::unique_ptr<storage_type[]> buffer;
+    size_type mask;
+    size_type head;
+    size_type tail;
+
+    unsigned long id;
+    std::atomic<record *> records;
+    char pad0[cache_line_size];
+    std::atomic<bool> combiner;
+    char pad1[cache_line_size - sizeof(std::atomic<bool>)];
+    // The number of elements, published by the combiner for empty().
+    std::atomic<size_type> size_hint;
+    char pad2[cache_line_size - sizeof(std::atomic<size_type>)];
+};
+
+template<typename T>
+flat_combining_queue<T>::
+flat_combining_queue(size_type capacity) :
+    mask(1),
+    head(0),
+    tail(0),
+    id(_::next_domain_id()),
+    records(nullptr),
+    combiner(false),
+    size_hint(0)
+{
+    while (mask + 1 < capacity) mask = (mask << 1) | 1;
+    buffer.reset(new storage_type[mask + 1]);
+}
+
+template<typename T>
+flat_combining_queue<T>::
+~flat_combining_queue()
+{
+    for (; head != tail; ++head) element(head)->~T();
+
+    record *r = records.load(std::memory_order_relaxed);
+    while (r) {
+        record *next = r->next;
+        delete r;
+        r = next;
+    }
+}
+
+template<typename T>
+typename flat_combining_queue<T>::size_type
+flat_combining_queue<T>::
+capacity() const noexcept
+{
+    return mask + 1;
+}
+
+template<typename T>
+bool
+flat_combining_queue<T>::
+try_push(T const& value)
+{
+    // Copy here rather than in the combiner, which must not throw.
+    T copy(value);
+    return try_push(std::move(copy));
+}
+
+template<typename T>
+bool
+flat_combining_queue<T>::
+try_push(T && value)
+{
+    record &r = acquire_record();
+    r.source = &value;
+    bool pushed = submit(r, push_request);
+    release_record(r);
+    return pushed;
+}
+
+template<typename T>
+template<typename... Args>
+bool
+flat_combining_queue<T>::
+try_emplace(Args&&... args)
+{
+    T value(std::forward<Args>(args)...);
+    return try_push(std::move(value));
+}
+
+template<typename T>
+bool
+flat_combining_queue<T>::
+try_pop(value_type &value)
+{
+    record &r = acquire_record();
+    auto release = scope_guard([this, &r] { release_record(r); });
+    if (!submit(r, pop_request)) return false;
+
+    T *popped = r.popped();
+    auto destroy = scope_guard([popped] { popped->~T(); });
+    value = std::move(*popped);
+    return true;
+}
+
+template<typename T>
+typename flat_combining_queue<T>::value_type
+flat_combining_queue<T>::
+pop()
+{
+    record &r = acquire_record();
+    spin_wait spin;
+    while (!submit(r, pop_request)) spin.wait();
+
+    T *popped = r.popped();
+    value_type value(std::move(*popped));
+    popped->~T();
+    release_record(r);
+    return value;
+}
+
+template<typename T>
+void
+flat_combining_queue<T>::
+push(T const& value)
+{
+    T copy(value);
+    push(std::move(copy));
+}
+
+template<typename T>
+void
+flat_combining_queue<T>::
+push(T && value)
+{
+    record &r = acquire_record();
+    r.source = &value;
+    spin_wait spin;
+    while (!submit(r, push_request)) spin.wait();
+    release_record(r);
+}
+
+template<typename T>
+template<typename... Args>
+void
+flat_combining_queue<T>::
+emplace(Args&&... args)
+{
+    T value(std::forward<Args>(args)...);
+    push(std::move(value));
+}
+
+template<typename T>
+bool
+flat_combining_queue<T>::
+empty() const
+{
+    return size_hint.load(std::memory_order_acquire) == 0;
+}
+
+template<typename T>
+typename flat_combining_queue<T>::record &
+flat_combining_queue<T>::
+acquire_record()
+{
+    /*
+     * Each thread remembers the last record it used, which is free unless
+     * the thread is using the queue recursively, so in the common case every
+     * thread keeps a record of its own.
+     */
+    struct cache_entry
+    {
+        unsigned long id;
+        record *rec;
+    };
+    static thread_local cache_entry cache = {0, nullptr};
+
+    if (cache.id == id) {
+        bool expected = false;
+        if (!cache.rec->owned.load(std::memory_order_relaxed) &&
+            cache.rec->owned.compare_exchange_strong(
+                    expected, true, std::memory_order_acquire)) {
+            return *cache.rec;
+        }
+    }
+
+    record &r = find_record();
+    cache.id = id;
+    cache.rec = &r;
+    return r;
+}
+
+template<typename T>
+typename flat_combining_queue<T>::record &
+flat_combining_queue<T>::
+find_record()
+{
+    for (record *r = records.load(std::memory_order_acquire);
+         r; r = r->next) {
+        bool expected = false;
+        if (!r->owned.load(std::memory_order_relaxed) &&
+            r->owned.compare_exchange_strong(
+                    expected, true, std::memory_order_acquire)) {
+            return *r;
+        }
+    }
+
+    // Every record is in use, so add a new one. Records are never removed.
+    record *r = new record;
+    r->next = records.load(std::memory_order_relaxed);
+    while (!records.compare_exchange_weak(r->next, r,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {}
+    return *r;
+}
+
+template<typename T>
+void
+flat_combining_queue<T>::
+release_record(record &r)
+{
+    r.owned.store(false, std::memory_order_release);
+}
+
+template<typename T>
+bool
+flat_combining_queue<T>::
+submit(record &r, request_state request)
+{
+    r.state.store(request, std::memory_order_release);
+
+    spin_wait spin;
+    for (;;) {
+        unsigned state = r.state.load(std::memory_order_acquire);
+        if (state == succeeded || state == failed) {
+            r.state.store(idle, std::memory_order_relaxed);
+            return state == succeeded;
+        }
+        if (!combiner.load(std::memory_order_relaxed)
+                && !combiner.exchange(true, std::memory_order_acquire)) {
+            // Our own request is served by this pass, if by no earlier one.
+            combine();
+            combiner.store(false, std::memory_order_release);
+            continue;
+        }
+        spin.wait();
+    }
+}
+
+template<typename T>
+void
+flat_combining_queue<T>::
+combine()
+{
+    for (unsigned pass = 0; pass < combine_passes; ++pass) {
+        bool served = false;
+        for (record *r = records.load(std::memory_order_acquire);
+             r; r = r->next) {
+            unsigned state = r->state.load(std::memory_order_acquire);
+            bool ok;
+            if (state == push_request) {
+                ok = apply_push(*r->source);
+            } else if (state == pop_request) {
+                ok = apply_pop(r->popped());
+            } else {
+                continue;
+            }
+            r->state.store(ok ? succeeded : failed, std::memory_order_release);
+            served = true;
+        }
+        if (!served) break;
+    }
+    size_hint.store(tail - head, std::memory_order_release);
+}
+
+template<typename T>
+bool
+flat_combining_queue<T>::
+apply_push(T &source)
+{
+    if (tail - head == capacity()) return false;
+    ::new (element(tail)) T(std::move(source));
+    ++tail;
+    return true;
+}
+
+template<typename T>
+bool
+flat_combining_queue<T>::
+apply_pop(T *dest)
+{
+    if (head == tail) return false;
+    T *elem = element(head);
+    ::new (dest) T(std::move(*elem));
+    elem->~T();
+    ++head;
+    return true;
+}
+
+template<typename T>
+T *
+flat_combining_queue<T>::
+element(size_type pos)
+{
+    return reinterpret_cast<T *>(&buffer[pos & mask]);
+}
+
+} // namespace sky
+
+#endif // FLAT_COMBINING_QUEUE_HPP
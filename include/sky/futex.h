@@ -0,0 +1,55 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <atomic>
+#include <chrono>
+
+namespace sky {
+
+/**
+ * @brief Blocks the calling thread while an atomic word holds a given value.
+ *
+ * The check and the sleep are a single atomic step with respect to
+ * futex_wake(), so a thread that changes the word and then wakes the
+ * waiters cannot be missed. On Linux this is the futex system call; on
+ * other systems it falls back to a table of condition variables.
+ *
+ * The call may also return spuriously, so callers must check the word
+ * again, in a loop.
+ *
+ * @param word The word to wait on.
+ * @param expected The value to sleep on. If the word holds any other value,
+ *        the call returns immediately.
+ */
+void futex_wait(std::atomic<int> &word, int expected) noexcept;
+
+/**
+ * @brief Blocks the calling thread while an atomic word holds a given value,
+ * for at most the given duration.
+ *
+ * As futex_wait(), the call may return early, so callers must check both
+ * the word and the time again.
+ *
+ * @param word The word to wait on.
+ * @param expected The value to sleep on.
+ * @param timeout The maximum amount of time to sleep.
+ */
+void futex_wait_for(std::atomic<int> &word, int expected,
+                    std::chrono::nanoseconds timeout) noexcept;
+
+/**
+ * @brief Wakes threads that are blocked in futex_wait() on a word.
+ * @param word The word the threads wait on.
+ * @param count The maximum number of threads to wake.
+ */
+void futex_wake(std::atomic<int> &word, int count) noexcept;
+
+/**
+ * @brief Wakes every thread that is blocked in futex_wait() on a word.
+ * @param word The word the threads wait on.
+ */
+void futex_wake_all(std::atomic<int> &word) noexcept;
+
+} // namespace sky
+
+#endif // FUTEX_H
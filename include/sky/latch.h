@@ -0,0 +1,68 @@
+#ifndef LATCH_H
+#define LATCH_H
+
+#include <atomic>
+
+namespace sky {
+
+/**
+ * @brief A single-use countdown that threads can wait on.
+ *
+ * A latch starts with an expected number of arrivals. Threads count it
+ * down, and every thread that waits on the latch is released once the count
+ * reaches zero. Unlike sky::barrier, a latch cannot be reused, and the
+ * threads that count it down need not be the ones that wait.
+ *
+ * Counting down is a single atomic instruction, plus a call to the kernel
+ * from the thread that reaches zero if someone sleeps on the latch. Waiting
+ * threads spin for a short while before they sleep, through
+ * sky::futex_wait().
+ */
+class latch
+{
+public:
+    /**
+     * @brief Creates a latch.
+     * @param expected The number of arrivals before the latch opens, between
+     *        0 and INT_MAX / 2.
+     */
+    explicit latch(int expected);
+
+    latch(latch const&) = delete;
+    latch &operator =(latch const&) = delete;
+
+    /**
+     * @brief Counts the latch down, without waiting.
+     * @param n The number of arrivals, at most the remaining count.
+     */
+    void count_down(int n = 1);
+
+    /**
+     * @brief Determines whether the count has reached zero.
+     */
+    bool try_wait() const noexcept;
+
+    /**
+     * @brief Waits until the count reaches zero.
+     */
+    void wait() const;
+
+    /**
+     * @brief Counts the latch down, and waits until the count reaches zero.
+     * @param n The number of arrivals, at most the remaining count.
+     */
+    void arrive_and_wait(int n = 1);
+
+private:
+    /*
+     * The futex word: twice the remaining count, plus one if a thread may
+     * be asleep. Keeping both in one word lets the last count_down() learn
+     * whether to wake anyone from its own decrement, without touching the
+     * latch again after the waiters may have destroyed it.
+     */
+    mutable std::atomic<int> state;
+};
+
+} // namespace sky
+
+#endif // LATCH_H
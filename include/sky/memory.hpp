@@ -1,7 +1,9 @@
 #ifndef MEMORY_HPP
 #define MEMORY_HPP
 
+#include <cstddef>
 #include <memory>
+#include <new>
 #include <utility>
 #include <type_traits>
 
@@ -16,6 +18,59 @@ template<typename T, typename... Args>
 std::unique_ptr<T>
 make_unique(Args&&... args);
 
+/** @brief Destroys and deallocates an array obtained from an allocator
+ *
+ * This is the deleter of the std::unique_ptr returned by allocate_unique().
+ * It keeps a copy of the allocator and the length of the array.
+ */
+template<typename Alloc>
+class allocator_deleter
+{
+    typedef std::allocator_traits<Alloc> traits;
+
+public:
+    typedef typename traits::value_type value_type;
+
+    allocator_deleter() : count(0) {}
+
+    allocator_deleter(Alloc const& alloc, std::size_t count) :
+        alloc(alloc),
+        count(count)
+    {}
+
+    void operator ()(value_type *p)
+    {
+        for (std::size_t i = count; i > 0; --i) {
+            traits::destroy(alloc, p + i - 1);
+        }
+        traits::deallocate(alloc, p, count);
+    }
+
+    Alloc const& get_allocator() const noexcept
+    {
+        return alloc;
+    }
+
+private:
+    Alloc alloc;
+    std::size_t count;
+};
+
+template<typename T, typename Alloc>
+using allocator_unique_ptr = std::unique_ptr<T[], allocator_deleter<
+    typename std::allocator_traits<Alloc>::template rebind_alloc<T>>>;
+
+/**
+ * @brief Allocates an array of value-initialized elements of type T from
+ * an allocator, and wraps it in a std::unique_ptr.
+ * @param alloc The allocator, which is rebound to T.
+ * @param n The number of elements.
+ * @return A std::unique_ptr that returns the array to the allocator.
+ */
+template<typename T, typename Alloc>
+allocator_unique_ptr<T, Alloc>
+allocate_unique(Alloc const& alloc, std::size_t n);
+
 namespace _ {
 
 template<typename T, typename... Args>
@@ -51,6 +106,27 @@ make_unique(Args&&... args)
                 std::forward<Args>(args)...);
 }
 
+template<typename T, typename Alloc>
+allocator_unique_ptr<T, Alloc>
+allocate_unique(Alloc const& alloc, std::size_t n)
+{
+    typedef typename std::allocator_traits<Alloc>::
+        template rebind_alloc<T> rebound;
+    typedef std::allocator_traits<rebound> traits;
+
+    rebound a(alloc);
+    T *p = traits::allocate(a, n);
+    std::size_t i = 0;
+    try {
+        for (; i < n; ++i) traits::construct(a, p + i);
+    } catch (...) {
+        while (i > 0) traits::destroy(a, p + --i);
+        traits::deallocate(a, p, n);
+        throw;
+    }
+    return allocator_unique_ptr<T, Alloc>(p, allocator_deleter<rebound>(a, n));
+}
+
 } // namespace sky
 
 #endif // MEMORY_HPP
@@ -0,0 +1,226 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "sky/atomic.hpp"
+#include "sky/atomic_histogram.hpp"
+#include "sky/os.h"
+
+namespace sky {
+
+/** @brief A set of named counters and histograms that can be exported in the
+ * Prometheus text format
+ *
+ * The registry only keeps references to the metrics, which must outlive it.
+ * The threads that update the metrics never see the registry: exporting
+ * reads every metric with relaxed loads, so it costs the hot path no locks,
+ * no allocations and no stores to shared cache lines.
+ *
+ * Every add() grows an output buffer large enough for the longest possible
+ * export, so that export_to() formats into that buffer without allocating,
+ * and hands it to the output in a single write. Histograms are exported as
+ * Prometheus summaries, with the 50th, 90th, 99th and 99.9th percentiles.
+ * A histogram keeps bucket counts rather than the values themselves, so the
+ * exported _sum is not the exact sum of the recorded values: every value
+ * counts as the midpoint of its bucket, which is off by at most 1/64 of the
+ * value. Values below 32 are summed exactly.
+ *
+ * Exports from several threads, and additions of metrics, are serialized by
+ * a lock of the registry's own, so metrics may be added at any time, even
+ * while a metrics_exporter runs.
+ *
+ * The following operations are disabled:
+ *  - copying and moving
+ */
+class metrics_registry
+{
+public:
+    metrics_registry();
+
+    metrics_registry(metrics_registry const&) = delete;
+    metrics_registry &operator =(metrics_registry const&) = delete;
+
+    /**
+     * @brief Adds a counter.
+     * @param name The name of the metric, which must be a valid Prometheus
+     *        metric name, that is, match `[a-zA-Z_:][a-zA-Z0-9_:]*`.
+     * @param help A description of the metric.
+     * @param counter The counter, which must outlive the registry.
+     * @throws std::invalid_argument If the name is invalid or already taken.
+     */
+    template<typename T, std::size_t Stripes>
+    void add(std::string const& name, std::string const& help,
+             atomic_counter<T, Stripes> const& counter);
+
+    /**
+     * @brief Adds a histogram.
+     * @param name The name of the metric, as for counters.
+     * @param help A description of the metric.
+     * @param histogram The histogram, which must outlive the registry.
+     * @throws std::invalid_argument If the name is invalid or already taken.
+     */
+    template<std::size_t Stripes>
+    void add(std::string const& name, std::string const& help,
+             atomic_histogram<Stripes> const& histogram);
+
+    /**
+     * @brief The number of metrics in the registry.
+     */
+    std::size_t size() const noexcept;
+
+    /**
+     * @brief Formats the current values of all metrics.
+     *
+     * The result stays valid until the next call to add(), format() or
+     * export_to().
+     *
+     * @param length Assigned the length of the result, in bytes.
+     * @return The start of the result, which is not null-terminated.
+     */
+    char const *format(std::size_t &length);
+
+    /**
+     * @brief Writes the current values of all metrics to an output.
+     *
+     * The whole export is passed to a single write, which is only repeated
+     * if the output accepts fewer bytes than that.
+     *
+     * @param out The output to write to.
+     * @return The number of bytes written.
+     */
+    std::size_t export_to(output out);
+
+private:
+    enum metric_kind
+    {
+        counter_kind,
+        histogram_kind
+    };
+
+    struct metric
+    {
+        metric_kind kind;
+        std::string name;
+        // The "# HELP" and "# TYPE" lines, formatted in advance.
+        std::string header;
+        void const *source;
+        int (*print)(void const *source, char *buf, std::size_t size);
+        void (*load)(void const *source, histogram_snapshot &into);
+    };
+
+    template<typename T, std::size_t Stripes>
+    static int print_counter(void const *source, char *buf, std::size_t size);
+
+    template<std::size_t Stripes>
+    static void load_histogram(void const *source, histogram_snapshot &into);
+
+    void add_metric(metric m, std::string const& help, char const *type);
+
+    std::size_t format_locked();
+    std::size_t format_counter(metric const& m, char *buf);
+    std::size_t format_histogram(metric const& m, char *buf);
+
+    // Serializes exports and additions.
+    mutable std::mutex export_mutex;
+    std::vector<metric> metrics;
+    std::vector<char> buffer;
+    histogram_snapshot scratch;
+};
+
+/** @brief Exports a metrics_registry to an output at regular intervals
+ *
+ * The exporter runs a thread of its own, which exports the registry once
+ * every period, and once more when the exporter is destroyed. The registry
+ * and the output must outlive the exporter. Errors from the output stop
+ * the exports silently.
+ *
+ * The following operations are disabled:
+ *  - copying and moving
+ */
+class metrics_exporter
+{
+public:
+    /**
+     * @brief Starts exporting.
+     * @param registry The metrics to export.
+     * @param out The output to export to.
+     * @param period The time between two exports.
+     */
+    metrics_exporter(metrics_registry &registry, output out,
+                     std::chrono::milliseconds period);
+
+    metrics_exporter(metrics_exporter const&) = delete;
+    metrics_exporter &operator =(metrics_exporter const&) = delete;
+
+    /**
+     * @brief Exports one last time, and stops.
+     */
+    ~metrics_exporter();
+
+private:
+    void run();
+
+    metrics_registry &registry;
+    output out;
+    std::chrono::milliseconds period;
+    std::mutex stop_mutex;
+    std::condition_variable stop_signal;
+    bool stopping;
+    std::thread thread;
+};
+
+template<typename T, std::size_t Stripes>
+void
+metrics_registry::
+add(std::string const& name, std::string const& help,
+    atomic_counter<T, Stripes> const& counter)
+{
+    metric m = {counter_kind, name, std::string(), &counter,
+                &print_counter<T, Stripes>, nullptr};
+    add_metric(std::move(m), help, "counter");
+}
+
+template<std::size_t Stripes>
+void
+metrics_registry::
+add(std::string const& name, std::string const& help,
+    atomic_histogram<Stripes> const& histogram)
+{
+    metric m = {histogram_kind, name, std::string(), &histogram,
+                nullptr, &load_histogram<Stripes>};
+    add_metric(std::move(m), help, "summary");
+}
+
+template<typename T, std::size_t Stripes>
+int
+metrics_registry::
+print_counter(void const *source, char *buf, std::size_t size)
+{
+    T value = static_cast<atomic_counter<T, Stripes> const *>(source)->load();
+    if (std::is_signed<T>::value) {
+        return std::snprintf(buf, size, "%lld", (long long)value);
+    }
+    return std::snprintf(buf, size, "%llu", (unsigned long long)value);
+}
+
+template<std::size_t Stripes>
+void
+metrics_registry::
+load_histogram(void const *source, histogram_snapshot &into)
+{
+    static_cast<atomic_histogram<Stripes> const *>(source)->load(into);
+}
+
+} // namespace sky
+
+#endif // METRICS_H
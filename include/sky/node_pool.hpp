@@ -0,0 +1,181 @@
+#ifndef NODE_POOL_HPP
+#define NODE_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace sky {
+
+/** @brief Allocates the nodes of a linked data structure in chunks
+ *
+ * A node pool hands out nodes many at a time, in chunks of a fixed size
+ * that are obtained from the allocator. It never takes individual nodes
+ * back: the data structure that owns the pool keeps its own free lists and
+ * recycles nodes itself, and every chunk is returned to the allocator when
+ * the pool is destroyed. Once the data structure has grown to its working
+ * size, its hot path therefore no longer reaches the allocator.
+ *
+ * allocate_chunk() may be called concurrently, as long as the allocator
+ * may also be used concurrently, as std::allocator may.
+ *
+ * The following operations are disabled:
+ *  - copying and moving
+ */
+template<typename Node, typename Alloc = std::allocator<Node>>
+class node_pool
+{
+    typedef typename std::allocator_traits<Alloc>::
+        template rebind_alloc<Node> node_allocator;
+    typedef std::allocator_traits<node_allocator> node_traits;
+
+public:
+    typedef Node node_type;
+    typedef Alloc allocator_type;
+    typedef std::size_t size_type;
+
+    static constexpr size_type default_chunk_size = 64;
+
+    /**
+     * @brief Creates a pool that has not allocated anything yet.
+     * @param chunk_size The number of nodes in a chunk, at least 1.
+     * @param alloc The allocator, which is rebound to allocate nodes.
+     */
+    explicit node_pool(size_type chunk_size = default_chunk_size,
+                       Alloc const& alloc = Alloc());
+
+    node_pool(node_pool const&) = delete;
+    node_pool &operator =(node_pool const&) = delete;
+
+    /**
+     * @brief Destroys all nodes, and returns all chunks to the allocator.
+     */
+    ~node_pool();
+
+    /**
+     * @brief Allocates a chunk of default-constructed nodes.
+     * @return The first of chunk_size() contiguous nodes, which stay valid
+     *         until the pool is destroyed.
+     */
+    Node *allocate_chunk();
+
+    /**
+     * @brief The number of nodes in a chunk.
+     */
+    size_type chunk_size() const noexcept;
+
+    /**
+     * @brief The number of chunks allocated so far.
+     */
+    size_type chunk_count() const noexcept;
+
+    allocator_type get_allocator() const;
+
+private:
+    struct chunk
+    {
+        chunk *next;
+        Node *nodes;
+    };
+
+    typedef typename std::allocator_traits<Alloc>::
+        template rebind_alloc<chunk> chunk_allocator;
+    typedef std::allocator_traits<chunk_allocator> chunk_traits;
+
+    node_allocator alloc;
+    size_type nodes_per_chunk;
+    std::atomic<chunk *> chunks;
+    std::atomic<size_type> count;
+};
+
+template<typename Node, typename Alloc>
+constexpr typename node_pool<Node, Alloc>::size_type
+node_pool<Node, Alloc>::default_chunk_size;
+
+template<typename Node, typename Alloc>
+node_pool<Node, Alloc>::
+node_pool(size_type chunk_size, Alloc const& alloc) :
+    alloc(alloc),
+    nodes_per_chunk(chunk_size ? chunk_size : 1),
+    chunks(nullptr),
+    count(0)
+{}
+
+template<typename Node, typename Alloc>
+node_pool<Node, Alloc>::
+~node_pool()
+{
+    chunk_allocator chunk_alloc(alloc);
+    chunk *c = chunks.load(std::memory_order_relaxed);
+    while (c) {
+        chunk *next = c->next;
+        for (size_type i = nodes_per_chunk; i > 0; --i) {
+            node_traits::destroy(alloc, c->nodes + i - 1);
+        }
+        node_traits::deallocate(alloc, c->nodes, nodes_per_chunk);
+        chunk_traits::deallocate(chunk_alloc, c, 1);
+        c = next;
+    }
+}
+
+template<typename Node, typename Alloc>
+Node *
+node_pool<Node, Alloc>::
+allocate_chunk()
+{
+    chunk_allocator chunk_alloc(alloc);
+    chunk *c = chunk_traits::allocate(chunk_alloc, 1);
+    try {
+        c->nodes = node_traits::allocate(alloc, nodes_per_chunk);
+    } catch (...) {
+        chunk_traits::deallocate(chunk_alloc, c, 1);
+        throw;
+    }
+
+    size_type i = 0;
+    try {
+        for (; i < nodes_per_chunk; ++i) {
+            node_traits::construct(alloc, c->nodes + i);
+        }
+    } catch (...) {
+        while (i > 0) node_traits::destroy(alloc, c->nodes + --i);
+        node_traits::deallocate(alloc, c->nodes, nodes_per_chunk);
+        chunk_traits::deallocate(chunk_alloc, c, 1);
+        throw;
+    }
+
+    c->next = chunks.load(std::memory_order_relaxed);
+    while (!chunks.compare_exchange_weak(c->next, c,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {}
+    count.fetch_add(1, std::memory_order_relaxed);
+    return c->nodes;
+}
+
+template<typename Node, typename Alloc>
+typename node_pool<Node, Alloc>::size_type
+node_pool<Node, Alloc>::
+chunk_size() const noexcept
+{
+    return nodes_per_chunk;
+}
+
+template<typename Node, typename Alloc>
+typename node_pool<Node, Alloc>::size_type
+node_pool<Node, Alloc>::
+chunk_count() const noexcept
+{
+    return count.load(std::memory_order_relaxed);
+}
+
+template<typename Node, typename Alloc>
+typename node_pool<Node, Alloc>::allocator_type
+node_pool<Node, Alloc>::
+get_allocator() const
+{
+    return allocator_type(alloc);
+}
+
+} // namespace sky
+
+#endif // NODE_POOL_HPP
@@ -0,0 +1,276 @@
+#ifndef QUEUE_STATS_HPP
+#define QUEUE_STATS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "sky/atomic.hpp"
+#include "sky/cpu.hpp"
+#include "sky/timer.h"
+
+namespace sky {
+
+/** @brief The statistics policy of a queue that keeps no statistics
+ *
+ * A statistics policy is notified by the queue it belongs to whenever
+ * elements are pushed or popped, and whenever a producer or consumer has to
+ * wait. The queue only does the work needed to notify the policy when the
+ * policy's `enabled` member is true, so with this policy the instrumentation
+ * compiles away entirely.
+ *
+ * A statistics policy must provide:
+ *  - `static constexpr bool enabled`
+ *  - `snapshot_type`, the type returned by snapshot()
+ *  - a constructor from the capacity of the queue, which is a power of two
+ *  - a move constructor and `swap()`
+ *  - `pushed(pos, n, depth)`: elements were written to the n slots from
+ *    position pos, and the queue held about depth elements afterwards. Called
+ *    before the elements are published.
+ *  - `popped(pos, n)`: the elements in the n slots from position pos are
+ *    about to be popped. Called before the slots are released.
+ *  - `producer_blocked()` and `consumer_blocked()`: a blocking push found the
+ *    queue full, or a blocking pop found it empty.
+ *  - `snapshot()`, which may be called concurrently with all of the above.
+ */
+struct null_queue_stats
+{
+    struct snapshot_type {};
+
+    static constexpr bool enabled = false;
+
+    explicit null_queue_stats(std::size_t) noexcept {}
+
+    void pushed(std::size_t, std::size_t, std::size_t) noexcept {}
+    void popped(std::size_t, std::size_t) noexcept {}
+    void producer_blocked() noexcept {}
+    void consumer_blocked() noexcept {}
+
+    snapshot_type snapshot() const noexcept
+    {
+        return snapshot_type();
+    }
+
+    void swap(null_queue_stats &) noexcept {}
+};
+
+/** @brief A statistics policy that counts operations and measures how long
+ * elements wait in the queue
+ *
+ * All counters are relaxed sky::atomic_counters. The counters written by
+ * producers and those written by consumers are kept on separate cache lines.
+ * Every element is stamped with the time it was pushed, which costs one
+ * clock reading on each push and each pop.
+ */
+class queue_stats
+{
+public:
+    typedef timer::clock clock;
+    typedef timer::duration duration;
+
+    /**
+     * @brief A snapshot of the statistics of a queue.
+     *
+     * The counters are read one at a time, so a snapshot taken while the
+     * queue is in use is not exactly consistent.
+     */
+    struct snapshot_type
+    {
+        /// The number of elements pushed.
+        std::uint64_t pushes;
+        /// The number of elements popped.
+        std::uint64_t pops;
+        /// The number of elements in the queue.
+        std::uint64_t depth;
+        /// The largest number of elements the queue has held.
+        std::uint64_t high_water;
+        /// The number of blocking pushes that found the queue full.
+        std::uint64_t producer_blocks;
+        /// The number of blocking pops that found the queue empty.
+        std::uint64_t consumer_blocks;
+        /// The total time popped elements spent in the queue.
+        duration total_wait;
+        /// The longest time a popped element spent in the queue.
+        duration max_wait;
+    };
+
+    static constexpr bool enabled = true;
+
+    explicit queue_stats(std::size_t capacity);
+
+    queue_stats(queue_stats &&other);
+
+    void pushed(std::size_t pos, std::size_t n, std::size_t depth) noexcept;
+    void popped(std::size_t pos, std::size_t n) noexcept;
+    void producer_blocked() noexcept;
+    void consumer_blocked() noexcept;
+
+    snapshot_type snapshot() const noexcept;
+
+    void swap(queue_stats &other) noexcept;
+
+private:
+    typedef clock::rep tick_type;
+
+    static void raise(std::atomic<std::uint64_t> &max,
+                      std::uint64_t value) noexcept;
+
+    std::unique_ptr<tick_type[]> stamps;
+    std::size_t mask;
+    char pad0[cache_line_size];
+
+    // Written by producers.
+    atomic_counter<std::uint64_t> pushes;
+    atomic_counter<std::uint64_t> producer_blocks;
+    std::atomic<std::uint64_t> high_water;
+    char pad1[cache_line_size];
+
+    // Written by consumers.
+    atomic_counter<std::uint64_t> pops;
+    atomic_counter<std::uint64_t> consumer_blocks;
+    atomic_counter<std::uint64_t> total_wait;
+    std::atomic<std::uint64_t> max_wait;
+    char pad2[cache_line_size];
+};
+
+inline
+queue_stats::
+queue_stats(std::size_t capacity) :
+    stamps(new tick_type[capacity]),
+    mask(capacity - 1),
+    pushes(0),
+    producer_blocks(0),
+    high_water(0),
+    pops(0),
+    consumer_blocks(0),
+    total_wait(0),
+    max_wait(0)
+{}
+
+inline
+queue_stats::
+queue_stats(queue_stats &&other) :
+    stamps(std::move(other.stamps)),
+    mask(other.mask),
+    pushes(other.pushes.load()),
+    producer_blocks(other.producer_blocks.load()),
+    high_water(other.high_water.load(std::memory_order_relaxed)),
+    pops(other.pops.load()),
+    consumer_blocks(other.consumer_blocks.load()),
+    total_wait(other.total_wait.load()),
+    max_wait(other.max_wait.load(std::memory_order_relaxed))
+{}
+
+inline
+void
+queue_stats::
+pushed(std::size_t pos, std::size_t n, std::size_t depth) noexcept
+{
+    tick_type now = clock::now().time_since_epoch().count();
+    for (std::size_t i = 0; i < n; ++i) stamps[(pos + i) & mask] = now;
+    pushes += n;
+    raise(high_water, depth);
+}
+
+inline
+void
+queue_stats::
+popped(std::size_t pos, std::size_t n) noexcept
+{
+    /*
+     * A stamp is written before its slot is published and read before the
+     * slot is released, so the queue's own synchronisation protects it.
+     */
+    tick_type now = clock::now().time_since_epoch().count();
+    std::uint64_t total = 0;
+    std::uint64_t longest = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        std::uint64_t wait = now - stamps[(pos + i) & mask];
+        total += wait;
+        if (wait > longest) longest = wait;
+    }
+    pops += n;
+    total_wait += total;
+    raise(max_wait, longest);
+}
+
+inline
+void
+queue_stats::
+producer_blocked() noexcept
+{
+    ++producer_blocks;
+}
+
+inline
+void
+queue_stats::
+consumer_blocked() noexcept
+{
+    ++consumer_blocks;
+}
+
+inline
+queue_stats::snapshot_type
+queue_stats::
+snapshot() const noexcept
+{
+    snapshot_type s;
+    s.pops = pops.load();
+    s.pushes = pushes.load();
+    // The two counters are read at different times.
+    s.depth = s.pushes > s.pops ? s.pushes - s.pops : 0;
+    s.high_water = high_water.load(std::memory_order_relaxed);
+    s.producer_blocks = producer_blocks.load();
+    s.consumer_blocks = consumer_blocks.load();
+    s.total_wait = duration(total_wait.load());
+    s.max_wait = duration(max_wait.load(std::memory_order_relaxed));
+    return s;
+}
+
+inline
+void
+queue_stats::
+swap(queue_stats &other) noexcept
+{
+    using std::swap;
+    swap(stamps, other.stamps);
+    swap(mask, other.mask);
+
+    // Counters can only be added to, so swap their values by difference.
+    auto swap_counts = [](atomic_counter<std::uint64_t> &a,
+                          atomic_counter<std::uint64_t> &b) {
+        std::uint64_t difference = b.load() - a.load();
+        a += difference;
+        b -= difference;
+    };
+    swap_counts(pushes, other.pushes);
+    swap_counts(producer_blocks, other.producer_blocks);
+    swap_counts(pops, other.pops);
+    swap_counts(consumer_blocks, other.consumer_blocks);
+    swap_counts(total_wait, other.total_wait);
+
+    high_water.store(other.high_water.exchange(
+                high_water.load(std::memory_order_relaxed),
+                std::memory_order_relaxed), std::memory_order_relaxed);
+    max_wait.store(other.max_wait.exchange(
+                max_wait.load(std::memory_order_relaxed),
+                std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+inline
+void
+queue_stats::
+raise(std::atomic<std::uint64_t> &max, std::uint64_t value) noexcept
+{
+    std::uint64_t current = max.load(std::memory_order_relaxed);
+    while (current < value
+           && !max.compare_exchange_weak(current, value,
+                                         std::memory_order_relaxed)) {}
+}
+
+} // namespace sky
+
+#endif // QUEUE_STATS_HPP
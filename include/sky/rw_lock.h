@@ -0,0 +1,130 @@
+#ifndef RW_LOCK_H
+#define RW_LOCK_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "sky/cpu.hpp"
+
+namespace sky {
+
+/**
+ * @brief A reader-writer lock for data that is read far more often than it
+ * is written.
+ *
+ * Readers do not share a reader count. Every reader marks a slot of its
+ * own, picked by sky::thread_index(), and every slot sits in a cache line
+ * of its own, so readers on different cores never write to the same line
+ * and the cost of lock_shared() stays flat as cores are added. A writer
+ * sets a flag, which turns new readers away, and then waits for every slot
+ * to drain, so writing costs time proportional to the number of slots.
+ *
+ * Writers take precedence: once a writer has set its flag, readers wait
+ * until it is done. Threads that wait for a writer sleep through
+ * sky::futex_wait(), while a writer that waits for readers spins, since
+ * read-side critical sections are expected to be short.
+ *
+ * sky::rw_lock meets the requirements of a Lockable and of a SharedLockable
+ * object. As with std::shared_mutex, a lock must be released by the thread
+ * that took it.
+ */
+class rw_lock
+{
+public:
+    /**
+     * @brief Creates an unlocked lock.
+     * @param slots The number of reader slots, which should be at least the
+     *        number of cores that read concurrently. 0 means the number of
+     *        hardware threads.
+     */
+    explicit rw_lock(std::size_t slots = 0);
+
+    rw_lock(rw_lock const&) = delete;
+    rw_lock &operator =(rw_lock const&) = delete;
+
+    /** @{
+     * @brief Takes the lock for writing.
+     */
+    void lock();
+    bool try_lock();
+    void unlock();
+    /// @}
+
+    /** @{
+     * @brief Takes the lock for reading, alongside other readers.
+     */
+    void lock_shared();
+    bool try_lock_shared();
+    void unlock_shared();
+    /// @}
+
+    /**
+     * @brief The number of reader slots.
+     */
+    std::size_t slot_count() const noexcept;
+
+private:
+    struct slot
+    {
+        std::atomic<unsigned> readers;
+        char pad[cache_line_size - sizeof(std::atomic<unsigned>)];
+
+        slot() : readers(0) {}
+    };
+
+    std::atomic<unsigned> &own_slot() noexcept;
+    void wait_for_writer();
+    void wait_for_readers();
+
+    std::unique_ptr<slot[]> slots;
+    std::size_t nslots;
+    /*
+     * The futex word: whether a writer holds, or is about to hold, the lock,
+     * and whether a thread may be asleep waiting for it.
+     */
+    std::atomic<int> writer;
+};
+
+inline void rw_lock::lock_shared()
+{
+    std::atomic<unsigned> &readers = own_slot();
+    for (;;) {
+        /*
+         * Pairs with lock(): either the writer sees our mark, or we see its
+         * flag.
+         */
+        readers.fetch_add(1, std::memory_order_seq_cst);
+        if (writer.load(std::memory_order_seq_cst) == 0) return;
+        readers.fetch_sub(1, std::memory_order_release);
+        wait_for_writer();
+    }
+}
+
+inline bool rw_lock::try_lock_shared()
+{
+    std::atomic<unsigned> &readers = own_slot();
+    readers.fetch_add(1, std::memory_order_seq_cst);
+    if (writer.load(std::memory_order_seq_cst) == 0) return true;
+    readers.fetch_sub(1, std::memory_order_release);
+    return false;
+}
+
+inline void rw_lock::unlock_shared()
+{
+    own_slot().fetch_sub(1, std::memory_order_release);
+}
+
+inline std::size_t rw_lock::slot_count() const noexcept
+{
+    return nslots;
+}
+
+inline std::atomic<unsigned> &rw_lock::own_slot() noexcept
+{
+    return slots[thread_index() % nslots].readers;
+}
+
+} // namespace sky
+
+#endif // RW_LOCK_H
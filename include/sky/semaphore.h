@@ -1,8 +1,8 @@
 #ifndef SEMAPHORE_H
 #define SEMAPHORE_H
 
-#include <condition_variable>
-#include <mutex>
+#include <atomic>
+#include <chrono>
 
 namespace sky {
 
@@ -14,10 +14,20 @@ namespace sky {
  * the pool, while acquiring causes a resource to be removed from the pool. If
  * there are no resources to acquire, then the thread that called acquire() will
  * block until a resource has been released. Alternatively, a thread may call
- * the non-blocking try_acquire().
+ * the non-blocking try_acquire(), or wait for a limited time with
+ * try_acquire_for() and try_acquire_until().
  *
- * sky::semaphore meets the requirements of a Lockable object and therefore
- * can be used with std::unique_lock and std::lock_guard.
+ * Several resources can be acquired and released at once, which makes a
+ * semaphore a budget of, say, connections or bytes. Acquiring n resources
+ * takes all of them in one step or none at all, and releasing n resources
+ * wakes up to n waiters with a single call to the kernel.
+ *
+ * The count is a single atomic word. Acquiring or releasing without
+ * contention is a single atomic instruction, and only a thread that has to
+ * wait for a resource goes to the kernel, through sky::futex_wait().
+ *
+ * sky::semaphore meets the requirements of a TimedLockable object and
+ * therefore can be used with std::unique_lock and std::lock_guard.
  * This facilitates the creation of "critical sections" that allows concurrent
  * access for up to a constant number of threads.
  */
@@ -46,6 +56,45 @@ public:
     bool try_lock();
     /// @}
 
+    /**
+     * @brief Try to acquire a number of resources from the semaphore at once.
+     * @param n The number of resources, at least 1.
+     * @return true iff all n resources were acquired.
+     */
+    bool try_acquire(int n);
+
+    /** @{
+     * @brief Try to acquire resources from the semaphore, waiting for at
+     * most the given duration.
+     * @param timeout The maximum amount of time to wait.
+     * @param n The number of resources, at least 1.
+     * @return true iff all n resources were acquired.
+     */
+    template<typename Rep, typename Period>
+    bool try_acquire_for(std::chrono::duration<Rep, Period> const& timeout,
+                         int n = 1);
+
+    template<typename Rep, typename Period>
+    bool try_lock_for(std::chrono::duration<Rep, Period> const& timeout);
+    /// @}
+
+    /** @{
+     * @brief Try to acquire resources from the semaphore, waiting until at
+     * most the given deadline.
+     * @param deadline The time at which to give up.
+     * @param n The number of resources, at least 1.
+     * @return true iff all n resources were acquired.
+     */
+    template<typename Clock, typename Duration>
+    bool try_acquire_until(
+            std::chrono::time_point<Clock, Duration> const& deadline,
+            int n = 1);
+
+    template<typename Clock, typename Duration>
+    bool try_lock_until(
+            std::chrono::time_point<Clock, Duration> const& deadline);
+    /// @}
+
     /** @{
      * @brief Acquires a resource from the semaphore.
      *
@@ -56,6 +105,16 @@ public:
     void lock();
     /// @}
 
+    /**
+     * @brief Acquires a number of resources from the semaphore at once.
+     *
+     * This function blocks until all n resources are available together, so
+     * it never holds some of them while it waits for the others.
+     *
+     * @param n The number of resources, at least 1.
+     */
+    void acquire(int n);
+
     /** @{
      * @brief Releases a resource back into the semaphore.
      *
@@ -66,13 +125,62 @@ public:
     void unlock();
     /// @}
 
+    /**
+     * @brief Releases a number of resources back into the semaphore at once.
+     *
+     * This is a non-blocking operation, which wakes up to n waiting threads
+     * with a single call.
+     *
+     * @param n The number of resources, at least 1.
+     */
+    void release(int n);
+
 private:
-    std::mutex resource_mutex;
-    std::condition_variable resource_available;
-    int resource_pool;
-    int released;
+    typedef std::chrono::steady_clock clock;
+
+    bool wait_for_resources(int n, clock::time_point const* deadline);
+
+    // The number of available resources, or minus the debt of a semaphore
+    // that was created with a negative number of them.
+    std::atomic<int> resource_pool;
+    // The number of threads that are, or are about to be, asleep, waiting
+    // for a single resource.
+    std::atomic<int> waiters;
+    // Likewise, for threads that wait for several resources at once.
+    std::atomic<int> bulk_waiters;
 };
 
+template<typename Rep, typename Period>
+bool semaphore::try_acquire_for(
+        std::chrono::duration<Rep, Period> const& timeout, int n)
+{
+    return try_acquire_until(clock::now() + timeout, n);
+}
+
+template<typename Rep, typename Period>
+bool semaphore::try_lock_for(std::chrono::duration<Rep, Period> const& timeout)
+{
+    return try_acquire_for(timeout);
+}
+
+template<typename Clock, typename Duration>
+bool semaphore::try_acquire_until(
+        std::chrono::time_point<Clock, Duration> const& deadline, int n)
+{
+    if (try_acquire(n)) return true;
+    // The futex only measures steady time, so convert the deadline once.
+    clock::time_point steady_deadline = clock::now()
+        + std::chrono::duration_cast<clock::duration>(deadline - Clock::now());
+    return wait_for_resources(n, &steady_deadline);
+}
+
+template<typename Clock, typename Duration>
+bool semaphore::try_lock_until(
+        std::chrono::time_point<Clock, Duration> const& deadline)
+{
+    return try_acquire_until(deadline);
+}
+
 } // namespace sky
 
 #endif // SEMAPHORE_H
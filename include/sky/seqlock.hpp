@@ -0,0 +1,166 @@
+#ifndef SEQLOCK_HPP
+#define SEQLOCK_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "sky/cpu.hpp"
+
+namespace sky {
+
+/** @brief A small value that one thread writes and many threads read,
+ * without the readers ever writing to shared memory
+ *
+ * A sequence number is odd while the writer is updating the value. Readers
+ * read the sequence number, then the value, then the sequence number again,
+ * and retry if it has changed or was odd. The writer never waits for the
+ * readers, and the readers never make the cache line bounce between cores,
+ * so reads scale with the number of readers as long as writes are rare.
+ *
+ * The value is kept in relaxed atomic words, and the sequence number is
+ * ordered around them with fences. A reader that races with the writer may
+ * copy a torn value, but discards it, and the race itself is well defined.
+ * As with sky::atomic_counter, the value carries no ordering of its own:
+ * only the sequence number does.
+ *
+ * store() may only be called by one thread at a time.
+ *
+ * The following operations are disabled:
+ *  - copying and moving
+ */
+template<typename T>
+class seqlock
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "T must be trivially copyable.");
+
+public:
+    typedef T value_type;
+
+    /**
+     * @brief Creates a seqlock with a value-initialized value.
+     */
+    seqlock() noexcept;
+
+    /**
+     * @brief Creates a seqlock with the given value.
+     */
+    explicit seqlock(T const& value) noexcept;
+
+    seqlock(seqlock const&) = delete;
+    seqlock &operator =(seqlock const&) = delete;
+
+    /**
+     * @brief Reads the value, retrying while the writer updates it.
+     */
+    T load() const noexcept;
+
+    /**
+     * @brief Reads the value, unless the writer updates it meanwhile.
+     * @param value Assigned the value, if it could be read.
+     * @return true iff the value was read.
+     */
+    bool try_load(T &value) const noexcept;
+
+    /**
+     * @brief Replaces the value.
+     */
+    void store(T const& value) noexcept;
+
+private:
+    typedef std::uintptr_t word_type;
+
+    static constexpr std::size_t word_count =
+        (sizeof(T) + sizeof(word_type) - 1) / sizeof(word_type);
+
+    bool read(unsigned before, T &value) const noexcept;
+    void write(T const& value) noexcept;
+
+    std::atomic<unsigned> sequence;
+    std::atomic<word_type> words[word_count];
+};
+
+template<typename T>
+seqlock<T>::
+seqlock() noexcept :
+    seqlock(T())
+{}
+
+template<typename T>
+seqlock<T>::
+seqlock(T const& value) noexcept :
+    sequence(0)
+{
+    write(value);
+}
+
+template<typename T>
+T
+seqlock<T>::
+load() const noexcept
+{
+    T value;
+    spin_wait spin;
+    while (!try_load(value)) spin.wait();
+    return value;
+}
+
+template<typename T>
+bool
+seqlock<T>::
+try_load(T &value) const noexcept
+{
+    unsigned before = sequence.load(std::memory_order_acquire);
+    if (before & 1) return false;
+    return read(before, value);
+}
+
+template<typename T>
+void
+seqlock<T>::
+store(T const& value) noexcept
+{
+    // Only this thread writes the sequence number.
+    unsigned before = sequence.load(std::memory_order_relaxed);
+    sequence.store(before + 1, std::memory_order_relaxed);
+    // Keeps the words from being written before the sequence is odd.
+    std::atomic_thread_fence(std::memory_order_release);
+    write(value);
+    sequence.store(before + 2, std::memory_order_release);
+}
+
+template<typename T>
+bool
+seqlock<T>::
+read(unsigned before, T &value) const noexcept
+{
+    word_type copy[word_count];
+    for (std::size_t i = 0; i < word_count; ++i) {
+        copy[i] = words[i].load(std::memory_order_relaxed);
+    }
+    // Keeps the words from being read after the sequence is checked again.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence.load(std::memory_order_relaxed) != before) return false;
+
+    std::memcpy(&value, copy, sizeof(T));
+    return true;
+}
+
+template<typename T>
+void
+seqlock<T>::
+write(T const& value) noexcept
+{
+    word_type copy[word_count] = {};
+    std::memcpy(copy, &value, sizeof(T));
+    for (std::size_t i = 0; i < word_count; ++i) {
+        words[i].store(copy[i], std::memory_order_relaxed);
+    }
+}
+
+} // namespace sky
+
+#endif // SEQLOCK_HPP
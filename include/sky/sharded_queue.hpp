@@ -0,0 +1,378 @@
+#ifndef SHARDED_QUEUE_HPP
+#define SHARDED_QUEUE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <type_traits>
+#include <vector>
+
+#include "sky/concurrent_queue.hpp"
+#include "sky/cpu.hpp"
+
+namespace sky {
+
+namespace _ {
+
+/*
+ * An output iterator that move-constructs the single element assigned
+ * through it into raw storage, so that popping into it needs no default
+ * constructed T.
+ */
+template<typename T>
+class construct_output
+{
+public:
+    explicit construct_output(T *dest) noexcept : dest(dest) {}
+
+    construct_output &operator *() noexcept { return *this; }
+    construct_output &operator ++() noexcept { return *this; }
+
+    construct_output &operator =(T &&value) noexcept
+    {
+        ::new (dest) T(std::move(value));
+        return *this;
+    }
+
+private:
+    T *dest;
+};
+
+} // namespace _
+
+/** @brief A sharded, multi-producer/multi-consumer queue without a global
+ * order
+ *
+ * The queue is made of several independent concurrent_queue shards, ideally
+ * one per core. Every thread has a home shard, chosen from its
+ * thread_index(). Producers push into their home shard, and consumers pop
+ * from their home shard first. Only when its home shard is empty does a
+ * consumer steal from the other shards, visiting them round-robin. In the
+ * common case threads on different cores therefore touch different head and
+ * tail indices, and throughput scales with the number of cores.
+ *
+ * The price is ordering: elements pushed by one thread are popped in FIFO
+ * order by any one consumer of the same shard, but there is no order between
+ * shards.
+ *
+ * push() and emplace() only wait when every shard is full, and then wait for
+ * room in the home shard. pop() waits until there is an element in any
+ * shard; it spins briefly and then parks on a condition variable, which
+ * every push checks for parked consumers.
+ *
+ * The following operations are disabled:
+ *  - copying
+ *  - back()
+ *  - size()
+ */
+template<typename T>
+class sharded_queue
+{
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef value_type &reference;
+    typedef value_type const& const_reference;
+
+    /**
+     * @brief Creates an empty queue.
+     *
+     * @param shards The number of shards. If 0, the number of hardware
+     *        threads is used.
+     * @param shard_capacity The maximum number of elements in each shard.
+     */
+    explicit sharded_queue(size_type shards = 0,
+                           size_type shard_capacity = 1024);
+
+    sharded_queue(sharded_queue const&) = delete;
+    sharded_queue &operator =(sharded_queue const&) = delete;
+
+    /**
+     * @brief The number of shards.
+     */
+    size_type shard_count() const noexcept;
+
+    /** @{
+     * @brief Pushes an element unless every shard is full.
+     * @return true iff the element was pushed.
+     */
+    bool try_push(T const& value);
+    bool try_push(T&& value);
+
+    template<typename... Args>
+    bool try_emplace(Args&&... args);
+    /// @}
+
+    /** @{
+     * @brief Pushes an element, waiting until there is room for it.
+     */
+    void push(T const& value);
+    void push(T&& value);
+
+    template<typename... Args>
+    void emplace(Args&&... args);
+    /// @}
+
+    /**
+     * @brief Pops an element unless every shard is empty.
+     * @param value Assigned the popped element, if any.
+     * @return true iff an element was popped.
+     */
+    bool try_pop(value_type &value);
+
+    /**
+     * @brief Pops an element, waiting until one is available.
+     */
+    value_type pop();
+
+    /**
+     * @brief Determines whether every shard is empty.
+     *
+     * Other threads may change the queue at any time, so the result is only
+     * a snapshot.
+     */
+    bool empty() const;
+
+private:
+    size_type home() const noexcept;
+
+    template<typename... Args>
+    bool try_construct(std::true_type, Args&&... args);
+
+    template<typename... Args>
+    bool try_construct(std::false_type, Args&&... args);
+
+    bool try_pop_into(T *result);
+
+    template<typename Pop>
+    void pop_or_park(Pop pop);
+
+    void wake_consumer();
+
+    std::vector<concurrent_queue<T>> shards;
+    char pad0[cache_line_size];
+    std::atomic<unsigned> parked_consumers;
+    char pad1[cache_line_size - sizeof(std::atomic<unsigned>)];
+    std::mutex park_mutex;
+    std::condition_variable not_empty;
+};
+
+template<typename T>
+sharded_queue<T>::
+sharded_queue(size_type shards, size_type shard_capacity) :
+    parked_consumers(0)
+{
+    if (shards == 0) shards = std::thread::hardware_concurrency();
+    if (shards == 0) shards = 1;
+    this->shards.reserve(shards);
+    for (size_type i = 0; i < shards; ++i) {
+        this->shards.emplace_back(shard_capacity);
+    }
+}
+
+template<typename T>
+typename sharded_queue<T>::size_type
+sharded_queue<T>::
+shard_count() const noexcept
+{
+    return shards.size();
+}
+
+template<typename T>
+bool
+sharded_queue<T>::
+try_push(T const& value)
+{
+    return try_emplace(value);
+}
+
+template<typename T>
+bool
+sharded_queue<T>::
+try_push(T && value)
+{
+    return try_emplace(std::move(value));
+}
+
+template<typename T>
+template<typename... Args>
+bool
+sharded_queue<T>::
+try_emplace(Args&&... args)
+{
+    if (!try_construct(std::is_nothrow_constructible<T, Args...>(),
+                       std::forward<Args>(args)...)) {
+        return false;
+    }
+    wake_consumer();
+    return true;
+}
+
+template<typename T>
+template<typename... Args>
+bool
+sharded_queue<T>::
+try_construct(std::true_type, Args&&... args)
+{
+    /*
+     * The arguments are only consumed by a push that succeeds, so they can
+     * be offered to every shard in turn.
+     */
+    size_type n = shards.size();
+    size_type start = home();
+    for (size_type i = 0; i < n; ++i) {
+        if (shards[(start + i) % n].try_emplace(std::forward<Args>(args)...)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename T>
+template<typename... Args>
+bool
+sharded_queue<T>::
+try_construct(std::false_type, Args&&... args)
+{
+    // Construct once, rather than once per shard that turns out to be full.
+    T value(std::forward<Args>(args)...);
+    return try_construct(std::true_type(), std::move(value));
+}
+
+template<typename T>
+void
+sharded_queue<T>::
+push(T const& value)
+{
+    emplace(value);
+}
+
+template<typename T>
+void
+sharded_queue<T>::
+push(T && value)
+{
+    emplace(std::move(value));
+}
+
+template<typename T>
+template<typename... Args>
+void
+sharded_queue<T>::
+emplace(Args&&... args)
+{
+    T value(std::forward<Args>(args)...);
+    if (!try_construct(std::true_type(), std::move(value))) {
+        shards[home()].push(std::move(value));
+    }
+    wake_consumer();
+}
+
+template<typename T>
+bool
+sharded_queue<T>::
+try_pop(value_type &value)
+{
+    size_type n = shards.size();
+    size_type start = home();
+    for (size_type i = 0; i < n; ++i) {
+        if (shards[(start + i) % n].try_pop(value)) return true;
+    }
+    return false;
+}
+
+template<typename T>
+typename sharded_queue<T>::value_type
+sharded_queue<T>::
+pop()
+{
+    // As in concurrent_priority_queue, T need not be default constructible.
+    typedef typename std::aligned_storage<
+        sizeof(T), std::alignment_of<T>::value>::type storage_type;
+    storage_type storage;
+    T *result = reinterpret_cast<T *>(&storage);
+
+    pop_or_park([this, result] { return try_pop_into(result); });
+
+    value_type value(std::move(*result));
+    result->~T();
+    return value;
+}
+
+template<typename T>
+bool
+sharded_queue<T>::
+empty() const
+{
+    for (auto const& shard : shards) {
+        if (!shard.empty()) return false;
+    }
+    return true;
+}
+
+template<typename T>
+bool
+sharded_queue<T>::
+try_pop_into(T *result)
+{
+    size_type n = shards.size();
+    size_type start = home();
+    _::construct_output<T> out(result);
+    for (size_type i = 0; i < n; ++i) {
+        if (shards[(start + i) % n].pop_into(out, 1)) return true;
+    }
+    return false;
+}
+
+template<typename T>
+template<typename Pop>
+void
+sharded_queue<T>::
+pop_or_park(Pop pop)
+{
+    spin_wait spin;
+    while (!spin.yielding()) {
+        if (pop()) return;
+        spin.wait();
+    }
+
+    /*
+     * Announce ourselves as parked before sweeping the shards one last time.
+     * A producer commits its element before checking for parked consumers,
+     * and the fences on both sides guarantee that either the producer sees
+     * us, or we see its element.
+     */
+    std::unique_lock<std::mutex> lock(park_mutex);
+    parked_consumers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (!pop()) not_empty.wait(lock);
+    parked_consumers.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template<typename T>
+void
+sharded_queue<T>::
+wake_consumer()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked_consumers.load(std::memory_order_relaxed) == 0) return;
+
+    { std::lock_guard<std::mutex> lock(park_mutex); }
+    not_empty.notify_one();
+}
+
+template<typename T>
+typename sharded_queue<T>::size_type
+sharded_queue<T>::
+home() const noexcept
+{
+    return thread_index() % shards.size();
+}
+
+} // namespace sky
+
+#endif // SHARDED_QUEUE_HPP
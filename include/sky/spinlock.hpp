@@ -0,0 +1,391 @@
+#ifndef SPINLOCK_HPP
+#define SPINLOCK_HPP
+
+#include <atomic>
+#include <thread>
+
+#include "sky/cpu.hpp"
+
+namespace sky {
+
+/**
+ * @defgroup spinlock Spinlocks
+ *
+ * Locks that busy-wait instead of sleeping, for critical sections that are
+ * only a few hundred cycles long, where putting a thread to sleep costs
+ * more than the wait itself. All of them can be used with std::lock_guard
+ * and std::unique_lock.
+ *
+ * - ttas_spinlock is the smallest and the fastest without contention, but
+ *   is unfair, and every handoff invalidates the lock in every waiter's
+ *   cache. Exponential backoff keeps the waiters from flooding the bus.
+ * - ticket_spinlock grants the lock in arrival order, but all waiters still
+ *   spin on the same cache line.
+ * - mcs_spinlock and clh_spinlock queue their waiters. Each waiter spins on
+ *   a node of its own, in a cache line of its own, so a handoff only touches
+ *   the next waiter's cache, and the lock is granted in arrival order.
+ *   Nodes come from a small thread-local cache, so locking does not
+ *   allocate once a thread has warmed up.
+ *
+ * Waiters that have spun for a while start to yield their time slice, as
+ * with sky::spin_wait, so that an oversubscribed machine still makes
+ * progress.
+ */
+
+namespace _ {
+
+// A queue node of mcs_spinlock and clh_spinlock.
+struct spin_node
+{
+    std::atomic<spin_node *> next;
+    std::atomic<bool> locked;
+    // The next node in the thread-local cache.
+    spin_node *free_next;
+    char pad[cache_line_size];
+
+    spin_node() : next(nullptr), locked(false), free_next(nullptr) {}
+};
+
+/*
+ * The nodes a thread is not currently queued with. A node may move to
+ * another thread's cache: a CLH lock hands its predecessor's node to the
+ * thread that acquired it.
+ */
+class spin_node_cache
+{
+public:
+    spin_node_cache() : head(nullptr) {}
+
+    spin_node_cache(spin_node_cache const&) = delete;
+    spin_node_cache &operator =(spin_node_cache const&) = delete;
+
+    ~spin_node_cache()
+    {
+        while (head) {
+            spin_node *next = head->free_next;
+            delete head;
+            head = next;
+        }
+    }
+
+    static spin_node_cache &local()
+    {
+        static thread_local spin_node_cache cache;
+        return cache;
+    }
+
+    spin_node *get()
+    {
+        if (!head) return new spin_node;
+        spin_node *n = head;
+        head = n->free_next;
+        return n;
+    }
+
+    void put(spin_node *n) noexcept
+    {
+        n->free_next = head;
+        head = n;
+    }
+
+private:
+    spin_node *head;
+};
+
+} // namespace _
+
+/**
+ * @brief A test-and-test-and-set spinlock with exponential backoff.
+ * @ingroup spinlock
+ *
+ * Waiters read the lock until it looks free, and only then try to take it.
+ * After every failed attempt a waiter pauses twice as long as after the
+ * previous one, up to max_backoff pauses, after which it yields instead.
+ */
+class ttas_spinlock
+{
+public:
+    /**
+     * @brief The longest pause between two attempts, in cpu_relax() calls.
+     */
+    static constexpr unsigned max_backoff = 1024;
+
+    ttas_spinlock() noexcept : locked(false) {}
+
+    ttas_spinlock(ttas_spinlock const&) = delete;
+    ttas_spinlock &operator =(ttas_spinlock const&) = delete;
+
+    void lock() noexcept;
+    bool try_lock() noexcept;
+    void unlock() noexcept;
+
+private:
+    std::atomic<bool> locked;
+};
+
+/**
+ * @brief A fair spinlock that grants the lock in arrival order.
+ * @ingroup spinlock
+ *
+ * Every thread draws a ticket, and waits until that ticket is served.
+ */
+class ticket_spinlock
+{
+public:
+    ticket_spinlock() noexcept : next(0), serving(0) {}
+
+    ticket_spinlock(ticket_spinlock const&) = delete;
+    ticket_spinlock &operator =(ticket_spinlock const&) = delete;
+
+    void lock() noexcept;
+    bool try_lock() noexcept;
+    void unlock() noexcept;
+
+private:
+    std::atomic<unsigned> next;
+    char pad[cache_line_size - sizeof(std::atomic<unsigned>)];
+    std::atomic<unsigned> serving;
+};
+
+/**
+ * @brief The Mellor-Crummey and Scott queue lock.
+ * @ingroup spinlock
+ *
+ * Waiters form a linked queue, and every waiter spins on the flag in its
+ * own node until its predecessor hands the lock over.
+ *
+ * The thread that unlocks must be the thread that locked.
+ */
+class mcs_spinlock
+{
+public:
+    mcs_spinlock() noexcept : tail(nullptr), holder(nullptr) {}
+
+    mcs_spinlock(mcs_spinlock const&) = delete;
+    mcs_spinlock &operator =(mcs_spinlock const&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock() noexcept;
+
+private:
+    typedef _::spin_node node;
+
+    std::atomic<node *> tail;
+    // The node of the thread that holds the lock.
+    node *holder;
+};
+
+/**
+ * @brief The Craig, Landin and Hagersten queue lock.
+ * @ingroup spinlock
+ *
+ * Waiters form an implicit queue, and every waiter spins on the flag in its
+ * predecessor's node. Unlike MCS, unlocking is a single store, but a
+ * waiter takes over its predecessor's node, so nodes travel between threads.
+ *
+ * clh_spinlock has no try_lock(): a thread cannot tell whether the node at
+ * the tail of the queue has been reused by another waiter since it looked,
+ * so it cannot join the queue only if the lock is free. It meets the
+ * requirements of a BasicLockable, which std::lock_guard needs.
+ */
+class clh_spinlock
+{
+public:
+    clh_spinlock();
+
+    clh_spinlock(clh_spinlock const&) = delete;
+    clh_spinlock &operator =(clh_spinlock const&) = delete;
+
+    ~clh_spinlock();
+
+    void lock();
+    void unlock() noexcept;
+
+private:
+    typedef _::spin_node node;
+
+    std::atomic<node *> tail;
+    // The node of the thread that holds the lock, and that of its
+    // predecessor, which it takes over when it unlocks.
+    node *holder;
+    node *predecessor;
+};
+
+inline
+void
+ttas_spinlock::
+lock() noexcept
+{
+    unsigned backoff = 1;
+    for (;;) {
+        if (!locked.load(std::memory_order_relaxed)
+                && !locked.exchange(true, std::memory_order_acquire)) {
+            return;
+        }
+        if (backoff < max_backoff) {
+            for (unsigned i = 0; i < backoff; ++i) cpu_relax();
+            backoff *= 2;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+inline
+bool
+ttas_spinlock::
+try_lock() noexcept
+{
+    return !locked.load(std::memory_order_relaxed)
+        && !locked.exchange(true, std::memory_order_acquire);
+}
+
+inline
+void
+ttas_spinlock::
+unlock() noexcept
+{
+    locked.store(false, std::memory_order_release);
+}
+
+inline
+void
+ticket_spinlock::
+lock() noexcept
+{
+    unsigned ticket = next.fetch_add(1, std::memory_order_relaxed);
+    spin_wait spin;
+    while (serving.load(std::memory_order_acquire) != ticket) spin.wait();
+}
+
+inline
+bool
+ticket_spinlock::
+try_lock() noexcept
+{
+    unsigned ticket = serving.load(std::memory_order_acquire);
+    unsigned expected = ticket;
+    // Draw a ticket only if it would be served right away.
+    return next.compare_exchange_strong(expected, ticket + 1,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed);
+}
+
+inline
+void
+ticket_spinlock::
+unlock() noexcept
+{
+    // Only the holder writes to serving.
+    serving.store(serving.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+}
+
+inline
+void
+mcs_spinlock::
+lock()
+{
+    node *self = _::spin_node_cache::local().get();
+    self->next.store(nullptr, std::memory_order_relaxed);
+    self->locked.store(true, std::memory_order_relaxed);
+
+    node *pred = tail.exchange(self, std::memory_order_acq_rel);
+    if (pred) {
+        pred->next.store(self, std::memory_order_release);
+        spin_wait spin;
+        while (self->locked.load(std::memory_order_acquire)) spin.wait();
+    }
+    holder = self;
+}
+
+inline
+bool
+mcs_spinlock::
+try_lock()
+{
+    node *self = _::spin_node_cache::local().get();
+    self->next.store(nullptr, std::memory_order_relaxed);
+
+    node *expected = nullptr;
+    if (!tail.compare_exchange_strong(expected, self,
+                                      std::memory_order_acq_rel,
+                                      std::memory_order_relaxed)) {
+        _::spin_node_cache::local().put(self);
+        return false;
+    }
+    holder = self;
+    return true;
+}
+
+inline
+void
+mcs_spinlock::
+unlock() noexcept
+{
+    node *self = holder;
+    node *succ = self->next.load(std::memory_order_acquire);
+    if (!succ) {
+        node *expected = self;
+        if (tail.compare_exchange_strong(expected, nullptr,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+            _::spin_node_cache::local().put(self);
+            return;
+        }
+        // A successor is queued, but has not linked itself to us yet.
+        spin_wait spin;
+        while (!(succ = self->next.load(std::memory_order_acquire))) {
+            spin.wait();
+        }
+    }
+    succ->locked.store(false, std::memory_order_release);
+    _::spin_node_cache::local().put(self);
+}
+
+inline
+clh_spinlock::
+clh_spinlock() :
+    tail(new node),
+    holder(nullptr),
+    predecessor(nullptr)
+{}
+
+inline
+clh_spinlock::
+~clh_spinlock()
+{
+    // The node at the tail belongs to no thread.
+    delete tail.load(std::memory_order_relaxed);
+}
+
+inline
+void
+clh_spinlock::
+lock()
+{
+    node *self = _::spin_node_cache::local().get();
+    self->locked.store(true, std::memory_order_relaxed);
+
+    node *pred = tail.exchange(self, std::memory_order_acq_rel);
+    spin_wait spin;
+    while (pred->locked.load(std::memory_order_acquire)) spin.wait();
+    holder = self;
+    predecessor = pred;
+}
+
+inline
+void
+clh_spinlock::
+unlock() noexcept
+{
+    node *pred = predecessor;
+    // Our successor now spins on our node, so we keep our predecessor's.
+    holder->locked.store(false, std::memory_order_release);
+    _::spin_node_cache::local().put(pred);
+}
+
+} // namespace sky
+
+#endif // SPINLOCK_HPP
@@ -0,0 +1,285 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include "sky/cpu.hpp"
+
+namespace sky {
+
+/** @brief A bounded, wait-free, single-producer/single-consumer queue
+ *
+ * At most one thread may push into the queue at a time, and at most one
+ * thread may pop from it at a time. In exchange, neither side ever issues a
+ * read-modify-write instruction: the producer owns the tail index, the
+ * consumer owns the head index, and each publishes its index with a release
+ * store that the other side reads with an acquire load.
+ *
+ * Each side also keeps a private copy of the other side's index, and only
+ * reloads the shared index when the copy says the queue is full (or empty).
+ * In the common case a push or pop therefore touches only cache lines that
+ * belong to its own side of the queue.
+ *
+ * push(), emplace() and pop() busy-wait until there is room in the queue, or
+ * an element in the queue, respectively.
+ *
+ * @tparam T The type of the elements.
+ * @tparam Capacity The maximum number of elements in the queue.
+ *         Must be a power of two.
+ */
+template<typename T, std::size_t Capacity>
+class spsc_queue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two.");
+
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef value_type &reference;
+    typedef value_type const& const_reference;
+
+    spsc_queue();
+
+    spsc_queue(spsc_queue const&) = delete;
+    spsc_queue &operator =(spsc_queue const&) = delete;
+
+    ~spsc_queue();
+
+    /**
+     * @brief The maximum number of elements in the queue.
+     */
+    static constexpr size_type capacity() noexcept
+    {
+        return Capacity;
+    }
+
+    /** @{
+     * @brief Pushes an element unless the queue is full.
+     *
+     * May only be called by the producer.
+     *
+     * @return true iff the element was pushed.
+     */
+    bool try_push(T const& value);
+    bool try_push(T&& value);
+
+    template<typename... Args>
+    bool try_emplace(Args&&... args);
+    /// @}
+
+    /**
+     * @brief Pops an element unless the queue is empty.
+     *
+     * May only be called by the consumer.
+     *
+     * @param value Assigned the popped element, if any.
+     * @return true iff an element was popped.
+     */
+    bool try_pop(value_type &value);
+
+    /**
+     * @brief Pops an element, waiting until one is available.
+     *
+     * May only be called by the consumer.
+     */
+    value_type pop();
+
+    /** @{
+     * @brief Pushes an element, waiting until there is room for it.
+     *
+     * May only be called by the producer.
+     */
+    void push(T const& value);
+    void push(T&& value);
+
+    template<typename... Args>
+    void emplace(Args&&... args);
+    /// @}
+
+    /**
+     * @brief Determines whether the queue is empty.
+     *
+     * The result is only a snapshot, unless called by the consumer, in which
+     * case the queue cannot become empty until the consumer pops again.
+     */
+    bool empty() const;
+
+private:
+    typedef std::atomic<size_type> index_type;
+    typedef typename std::aligned_storage<
+        sizeof(T), std::alignment_of<T>::value>::type storage_type;
+
+    static constexpr size_type mask = Capacity - 1;
+
+    T *element(size_type pos);
+
+    template<typename... Args>
+    void construct(size_type pos, Args&&... args);
+
+    std::unique_ptr<storage_type[]> buffer;
+    char pad0[cache_line_size];
+
+    // Written by the producer.
+    index_type tail;
+    size_type cached_head;
+    char pad1[cache_line_size - sizeof(index_type) - sizeof(size_type)];
+
+    // Written by the consumer.
+    index_type head;
+    size_type cached_tail;
+    char pad2[cache_line_size - sizeof(index_type) - sizeof(size_type)];
+};
+
+template<typename T, std::size_t Capacity>
+spsc_queue<T, Capacity>::
+spsc_queue() :
+    buffer(new storage_type[Capacity]),
+    tail(0),
+    cached_head(0),
+    head(0),
+    cached_tail(0)
+{}
+
+template<typename T, std::size_t Capacity>
+spsc_queue<T, Capacity>::
+~spsc_queue()
+{
+    size_type pos = head.load(std::memory_order_relaxed);
+    size_type end = tail.load(std::memory_order_relaxed);
+    for (; pos != end; ++pos) element(pos)->~T();
+}
+
+template<typename T, std::size_t Capacity>
+bool
+spsc_queue<T, Capacity>::
+try_push(T const& value)
+{
+    return try_emplace(value);
+}
+
+template<typename T, std::size_t Capacity>
+bool
+spsc_queue<T, Capacity>::
+try_push(T && value)
+{
+    return try_emplace(std::move(value));
+}
+
+template<typename T, std::size_t Capacity>
+template<typename... Args>
+bool
+spsc_queue<T, Capacity>::
+try_emplace(Args&&... args)
+{
+    size_type pos = tail.load(std::memory_order_relaxed);
+    if (pos - cached_head == Capacity) {
+        cached_head = head.load(std::memory_order_acquire);
+        if (pos - cached_head == Capacity) return false;
+    }
+    construct(pos, std::forward<Args>(args)...);
+    tail.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T, std::size_t Capacity>
+bool
+spsc_queue<T, Capacity>::
+try_pop(value_type &value)
+{
+    size_type pos = head.load(std::memory_order_relaxed);
+    if (pos == cached_tail) {
+        cached_tail = tail.load(std::memory_order_acquire);
+        if (pos == cached_tail) return false;
+    }
+    T *elem = element(pos);
+    value = std::move(*elem);
+    elem->~T();
+    head.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename T, std::size_t Capacity>
+typename spsc_queue<T, Capacity>::value_type
+spsc_queue<T, Capacity>::
+pop()
+{
+    size_type pos = head.load(std::memory_order_relaxed);
+    spin_wait spin;
+    while (pos == cached_tail) {
+        cached_tail = tail.load(std::memory_order_acquire);
+        if (pos == cached_tail) spin.wait();
+    }
+    T *elem = element(pos);
+    value_type value(std::move(*elem));
+    elem->~T();
+    head.store(pos + 1, std::memory_order_release);
+    return value;
+}
+
+template<typename T, std::size_t Capacity>
+void
+spsc_queue<T, Capacity>::
+push(T const& value)
+{
+    emplace(value);
+}
+
+template<typename T, std::size_t Capacity>
+void
+spsc_queue<T, Capacity>::
+push(T && value)
+{
+    emplace(std::move(value));
+}
+
+template<typename T, std::size_t Capacity>
+template<typename... Args>
+void
+spsc_queue<T, Capacity>::
+emplace(Args&&... args)
+{
+    size_type pos = tail.load(std::memory_order_relaxed);
+    spin_wait spin;
+    while (pos - cached_head == Capacity) {
+        cached_head = head.load(std::memory_order_acquire);
+        if (pos - cached_head == Capacity) spin.wait();
+    }
+    construct(pos, std::forward<Args>(args)...);
+    tail.store(pos + 1, std::memory_order_release);
+}
+
+template<typename T, std::size_t Capacity>
+bool
+spsc_queue<T, Capacity>::
+empty() const
+{
+    return head.load(std::memory_order_acquire)
+        == tail.load(std::memory_order_acquire);
+}
+
+template<typename T, std::size_t Capacity>
+T *
+spsc_queue<T, Capacity>::
+element(size_type pos)
+{
+    return reinterpret_cast<T *>(&buffer[pos & mask]);
+}
+
+template<typename T, std::size_t Capacity>
+template<typename... Args>
+void
+spsc_queue<T, Capacity>::
+construct(size_type pos, Args&&... args)
+{
+    ::new (element(pos)) T(std::forward<Args>(args)...);
+}
+
+} // namespace sky
+
+#endif // SPSC_QUEUE_HPP
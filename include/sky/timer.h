@@ -7,11 +7,11 @@ namespace sky {
 
 class timer
 {
+public:
     typedef std::chrono::steady_clock clock;
     typedef clock::time_point time_point;
     typedef clock::duration duration;
 
-public:
     timer();
     duration split() const;
 private:
@@ -0,0 +1,585 @@
+#ifndef UNBOUNDED_QUEUE_HPP
+#define UNBOUNDED_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+#include "sky/cpu.hpp"
+#include "sky/node_pool.hpp"
+
+namespace sky {
+
+/** @brief An unbounded, lock-free, multi-producer/multi-consumer queue
+ *
+ * This is a Michael-Scott queue: a singly linked list with a dummy node at
+ * its head, where producers append with a compare-and-swap on the last
+ * node's link and consumers advance the head pointer with a
+ * compare-and-swap.
+ *
+ * Popped nodes are reclaimed with hazard pointers. Before dereferencing a
+ * node, a thread publishes its address in a hazard record that belongs to
+ * the queue. A popped node is retired rather than freed, and retired nodes
+ * are only recycled once no hazard record refers to them. This rules out
+ * both use-after-free and the ABA problem on the head and tail pointers.
+ *
+ * Recycled nodes go onto a free list owned by the queue, and new elements
+ * are placed in recycled nodes whenever possible. New nodes are taken from
+ * a sky::node_pool, which obtains them from the allocator a chunk at a time.
+ * Once the queue has grown to its working size, push() and pop() therefore
+ * no longer call the allocator at all. Memory is only returned when the
+ * queue is destroyed.
+ *
+ * pop() busy-waits until there is an element in the queue.
+ *
+ * Construction and destruction are not thread-safe.
+ * The following operations are disabled:
+ *  - copying and moving
+ *  - back()
+ *  - size()
+ */
+template<typename T, typename Alloc = std::allocator<T>>
+class unbounded_queue
+{
+public:
+    typedef T value_type;
+    typedef std::size_t size_type;
+    typedef value_type &reference;
+    typedef value_type const& const_reference;
+    typedef Alloc allocator_type;
+
+    /**
+     * @brief Creates an empty queue.
+     * @param alloc The allocator, which is rebound to allocate nodes in
+     *        chunks. It may be used by several threads at once.
+     */
+    explicit unbounded_queue(Alloc const& alloc = Alloc());
+
+    unbounded_queue(unbounded_queue const&) = delete;
+    unbounded_queue &operator =(unbounded_queue const&) = delete;
+
+    ~unbounded_queue();
+
+    /** @{
+     * @brief Pushes an element.
+     *
+     * This never waits, since the queue is never full.
+     */
+    void push(T const& value);
+    void push(T&& value);
+
+    template<typename... Args>
+    void emplace(Args&&... args);
+    /// @}
+
+    /**
+     * @brief Pops an element unless the queue is empty.
+     * @param value Assigned the popped element, if any.
+     * @return true iff an element was popped.
+     */
+    bool try_pop(value_type &value);
+
+    /**
+     * @brief Pops an element, waiting until one is available.
+     */
+    value_type pop();
+
+    /**
+     * @brief Determines whether the queue is empty.
+     *
+     * Other threads may change the queue at any time, so the result is only
+     * a snapshot.
+     */
+    bool empty() const;
+
+    allocator_type get_allocator() const;
+
+private:
+    typedef typename std::aligned_storage<
+        sizeof(T), std::alignment_of<T>::value>::type storage_type;
+
+    struct node
+    {
+        std::atomic<node *> next;
+
+        // Links the node into a retired list or a free list.
+        node *link;
+
+        storage_type storage;
+
+        T *element()
+        {
+            return reinterpret_cast<T *>(&storage);
+        }
+    };
+
+    /*
+     * A hazard record is owned by one thread for the duration of one
+     * operation. Its retired and free lists are only touched by the owner,
+     * so they need no synchronization.
+     */
+    struct hazard_record
+    {
+        static constexpr std::size_t hazards_per_record = 2;
+
+        std::atomic<node *> hazards[hazards_per_record];
+        std::atomic<bool> active;
+        hazard_record *next;
+
+        node *retired;
+        size_type retired_count;
+        node *free;
+
+        // Scratch space for the hazard pointers seen during a scan.
+        std::unique_ptr<node *[]> seen;
+        size_type seen_capacity;
+
+        char pad[cache_line_size];
+    };
+
+    class operation;
+
+    hazard_record *acquire_record() const;
+    hazard_record *find_record() const;
+
+    static node *protect(hazard_record *rec, std::size_t index,
+                         std::atomic<node *> const& source);
+
+    node *allocate(hazard_record *rec);
+    node *allocate_chunk();
+    void retire(hazard_record *rec, node *n);
+    void scan(hazard_record *rec);
+
+    void link(hazard_record *rec, node *n);
+
+    template<typename Take>
+    bool dequeue(Take take);
+
+    node_pool<node, Alloc> pool;
+    unsigned long id;
+    mutable std::atomic<hazard_record *> records;
+    mutable std::atomic<size_type> record_count;
+    std::atomic<node *> free_nodes;
+    char pad0[cache_line_size];
+    std::atomic<node *> head;
+    char pad1[cache_line_size - sizeof(std::atomic<node *>)];
+    std::atomic<node *> tail;
+    char pad2[cache_line_size - sizeof(std::atomic<node *>)];
+};
+
+/*
+ * Owns a hazard record for the duration of one queue operation, and clears
+ * its hazard pointers when the operation is over.
+ */
+template<typename T, typename Alloc>
+class unbounded_queue<T, Alloc>::operation
+{
+public:
+    explicit operation(unbounded_queue const& queue) :
+        record(queue.acquire_record())
+    {}
+
+    operation(operation const&) = delete;
+    operation &operator =(operation const&) = delete;
+
+    ~operation()
+    {
+        for (auto &hazard : record->hazards) {
+            hazard.store(nullptr, std::memory_order_release);
+        }
+        record->active.store(false, std::memory_order_release);
+    }
+
+    hazard_record *const record;
+};
+
+template<typename T, typename Alloc>
+unbounded_queue<T, Alloc>::
+unbounded_queue(Alloc const& alloc) :
+    pool(node_pool<node, Alloc>::default_chunk_size, alloc),
+    id(_::next_domain_id()),
+    records(nullptr),
+    record_count(0),
+    free_nodes(nullptr)
+{
+    node *dummy = allocate_chunk();
+    free_nodes.store(dummy->link, std::memory_order_relaxed);
+    dummy->next.store(nullptr, std::memory_order_relaxed);
+    head.store(dummy, std::memory_order_relaxed);
+    tail.store(dummy, std::memory_order_relaxed);
+}
+
+template<typename T, typename Alloc>
+unbounded_queue<T, Alloc>::
+~unbounded_queue()
+{
+    // The nodes themselves are returned to the allocator by the pool.
+    node *dummy = head.load(std::memory_order_relaxed);
+    node *n = dummy->next.load(std::memory_order_relaxed);
+    for (; n; n = n->next.load(std::memory_order_relaxed)) {
+        n->element()->~T();
+    }
+
+    hazard_record *rec = records.load(std::memory_order_relaxed);
+    while (rec) {
+        hazard_record *next = rec->next;
+        delete rec;
+        rec = next;
+    }
+}
+
+template<typename T, typename Alloc>
+void
+unbounded_queue<T, Alloc>::
+push(T const& value)
+{
+    emplace(value);
+}
+
+template<typename T, typename Alloc>
+void
+unbounded_queue<T, Alloc>::
+push(T && value)
+{
+    emplace(std::move(value));
+}
+
+template<typename T, typename Alloc>
+template<typename... Args>
+void
+unbounded_queue<T, Alloc>::
+emplace(Args&&... args)
+{
+    operation op(*this);
+    node *n = allocate(op.record);
+    try {
+        ::new (n->element()) T(std::forward<Args>(args)...);
+    } catch (...) {
+        n->link = op.record->free;
+        op.record->free = n;
+        throw;
+    }
+    link(op.record, n);
+}
+
+template<typename T, typename Alloc>
+bool
+unbounded_queue<T, Alloc>::
+try_pop(value_type &value)
+{
+    return dequeue([&value](T &elem) { value = std::move(elem); });
+}
+
+template<typename T, typename Alloc>
+typename unbounded_queue<T, Alloc>::value_type
+unbounded_queue<T, Alloc>::
+pop()
+{
+    storage_type storage;
+    T *popped = reinterpret_cast<T *>(&storage);
+    auto take = [popped](T &elem) { ::new (popped) T(std::move(elem)); };
+
+    spin_wait spin;
+    while (!dequeue(take)) spin.wait();
+
+    value_type value(std::move(*popped));
+    popped->~T();
+    return value;
+}
+
+template<typename T, typename Alloc>
+template<typename Take>
+bool
+unbounded_queue<T, Alloc>::
+dequeue(Take take)
+{
+    operation op(*this);
+    for (;;) {
+        node *first = protect(op.record, 0, head);
+        node *last = tail.load(std::memory_order_acquire);
+        node *next = first->next.load(std::memory_order_acquire);
+        op.record->hazards[1].store(next, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (first != head.load(std::memory_order_acquire)) continue;
+
+        if (!next) return false;
+
+        if (first == last) {
+            // The tail is lagging behind; help the producer move it along.
+            tail.compare_exchange_strong(last, next,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed);
+            continue;
+        }
+
+        if (head.compare_exchange_strong(first, next,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+            /*
+             * next is now the dummy node, but only we may touch its element,
+             * and our hazard pointer keeps it from being recycled.
+             */
+            T *elem = next->element();
+            take(*elem);
+            elem->~T();
+            retire(op.record, first);
+            return true;
+        }
+    }
+}
+
+template<typename T, typename Alloc>
+bool
+unbounded_queue<T, Alloc>::
+empty() const
+{
+    operation op(*this);
+    node *first = protect(op.record, 0, head);
+    return first->next.load(std::memory_order_acquire) == nullptr;
+}
+
+template<typename T, typename Alloc>
+typename unbounded_queue<T, Alloc>::allocator_type
+unbounded_queue<T, Alloc>::
+get_allocator() const
+{
+    return pool.get_allocator();
+}
+
+template<typename T, typename Alloc>
+typename unbounded_queue<T, Alloc>::hazard_record *
+unbounded_queue<T, Alloc>::
+acquire_record() const
+{
+    /*
+     * Each thread remembers the last record it used, which is almost always
+     * free again by the time the thread starts its next operation.
+     */
+    struct cache_entry
+    {
+        unsigned long id;
+        hazard_record *record;
+    };
+    static thread_local cache_entry cache = {0, nullptr};
+
+    if (cache.id == id) {
+        bool expected = false;
+        if (!cache.record->active.load(std::memory_order_relaxed) &&
+            cache.record->active.compare_exchange_strong(
+                    expected, true, std::memory_order_acquire)) {
+            return cache.record;
+        }
+    }
+
+    hazard_record *rec = find_record();
+    cache.id = id;
+    cache.record = rec;
+    return rec;
+}
+
+template<typename T, typename Alloc>
+typename unbounded_queue<T, Alloc>::hazard_record *
+unbounded_queue<T, Alloc>::
+find_record() const
+{
+    for (hazard_record *rec = records.load(std::memory_order_acquire);
+         rec; rec = rec->next) {
+        bool expected = false;
+        if (!rec->active.load(std::memory_order_relaxed) &&
+            rec->active.compare_exchange_strong(
+                    expected, true, std::memory_order_acquire)) {
+            return rec;
+        }
+    }
+
+    // Every record is in use, so add a new one. Records are never removed.
+    hazard_record *rec = new hazard_record;
+    for (auto &hazard : rec->hazards) {
+        hazard.store(nullptr, std::memory_order_relaxed);
+    }
+    rec->active.store(true, std::memory_order_relaxed);
+    rec->retired = nullptr;
+    rec->retired_count = 0;
+    rec->free = nullptr;
+    rec->seen_capacity = 0;
+
+    rec->next = records.load(std::memory_order_relaxed);
+    while (!records.compare_exchange_weak(rec->next, rec,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {}
+    record_count.fetch_add(1, std::memory_order_relaxed);
+    return rec;
+}
+
+template<typename T, typename Alloc>
+typename unbounded_queue<T, Alloc>::node *
+unbounded_queue<T, Alloc>::
+protect(hazard_record *rec, std::size_t index,
+        std::atomic<node *> const& source)
+{
+    /*
+     * The hazard pointer is only valid if the source still refers to the
+     * node after the hazard pointer has become visible to other threads.
+     */
+    node *n = source.load(std::memory_order_relaxed);
+    for (;;) {
+        rec->hazards[index].store(n, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        node *current = source.load(std::memory_order_acquire);
+        if (current == n) return n;
+        n = current;
+    }
+}
+
+template<typename T, typename Alloc>
+typename unbounded_queue<T, Alloc>::node *
+unbounded_queue<T, Alloc>::
+allocate(hazard_record *rec)
+{
+    if (!rec->free) {
+        // Take the whole shared free list, which cannot suffer from ABA.
+        rec->free = free_nodes.exchange(nullptr, std::memory_order_acquire);
+    }
+
+    if (!rec->free) {
+        // Keep the rest of a new chunk for this thread's later pushes.
+        rec->free = allocate_chunk();
+    }
+
+    node *n = rec->free;
+    rec->free = n->link;
+    n->next.store(nullptr, std::memory_order_relaxed);
+    return n;
+}
+
+template<typename T, typename Alloc>
+typename unbounded_queue<T, Alloc>::node *
+unbounded_queue<T, Alloc>::
+allocate_chunk()
+{
+    // Returns the nodes of a new chunk, linked into a free list.
+    node *chunk = pool.allocate_chunk();
+    size_type last = pool.chunk_size() - 1;
+    for (size_type i = 0; i < last; ++i) chunk[i].link = &chunk[i + 1];
+    chunk[last].link = nullptr;
+    return chunk;
+}
+
+template<typename T, typename Alloc>
+void
+unbounded_queue<T, Alloc>::
+retire(hazard_record *rec, node *n)
+{
+    n->link = rec->retired;
+    rec->retired = n;
+    ++rec->retired_count;
+
+    /*
+     * Scanning costs time proportional to the number of hazard pointers,
+     * so only scan once there are enough retired nodes to pay for it.
+     */
+    size_type threshold = 2 * hazard_record::hazards_per_record
+            * record_count.load(std::memory_order_relaxed) + 16;
+    if (rec->retired_count >= threshold) scan(rec);
+}
+
+template<typename T, typename Alloc>
+void
+unbounded_queue<T, Alloc>::
+scan(hazard_record *rec)
+{
+    /*
+     * Collect every hazard pointer. If other threads have added records
+     * since the scratch space was sized, grow it and start over: skipping
+     * a hazard pointer could recycle a node that is still in use.
+     */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    size_type count;
+    for (;;) {
+        size_type needed = hazard_record::hazards_per_record
+                * record_count.load(std::memory_order_acquire);
+        if (rec->seen_capacity < needed) {
+            rec->seen.reset(new node *[2 * needed]);
+            rec->seen_capacity = 2 * needed;
+        }
+
+        count = 0;
+        hazard_record *other = records.load(std::memory_order_acquire);
+        for (; other; other = other->next) {
+            if (count + hazard_record::hazards_per_record
+                    > rec->seen_capacity) break;
+            for (auto &hazard : other->hazards) {
+                node *n = hazard.load(std::memory_order_acquire);
+                if (n) rec->seen[count++] = n;
+            }
+        }
+        if (!other) break;
+    }
+    node **seen = rec->seen.get();
+    std::sort(seen, seen + count);
+
+    node *still_retired = nullptr;
+    node *reclaimed = nullptr;
+    node *reclaimed_last = nullptr;
+    rec->retired_count = 0;
+    for (node *n = rec->retired, *next; n; n = next) {
+        next = n->link;
+        if (std::binary_search(seen, seen + count, n)) {
+            n->link = still_retired;
+            still_retired = n;
+            ++rec->retired_count;
+        } else {
+            if (!reclaimed) reclaimed_last = n;
+            n->link = reclaimed;
+            reclaimed = n;
+        }
+    }
+    rec->retired = still_retired;
+
+    if (reclaimed) {
+        // Pushing onto a stack is safe from ABA; only popping is not.
+        reclaimed_last->link = free_nodes.load(std::memory_order_relaxed);
+        while (!free_nodes.compare_exchange_weak(
+                    reclaimed_last->link, reclaimed,
+                    std::memory_order_release,
+                    std::memory_order_relaxed)) {}
+    }
+}
+
+template<typename T, typename Alloc>
+void
+unbounded_queue<T, Alloc>::
+link(hazard_record *rec, node *n)
+{
+    for (;;) {
+        node *last = protect(rec, 0, tail);
+        node *next = last->next.load(std::memory_order_acquire);
+        if (last != tail.load(std::memory_order_acquire)) continue;
+
+        if (next) {
+            // The tail is lagging behind; help the other producer.
+            tail.compare_exchange_strong(last, next,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed);
+            continue;
+        }
+
+        node *expected = nullptr;
+        if (last->next.compare_exchange_strong(expected, n,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+            tail.compare_exchange_strong(last, n,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+} // namespace sky
+
+#endif // UNBOUNDED_QUEUE_HPP
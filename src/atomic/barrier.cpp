@@ -0,0 +1,83 @@
+#include "sky/barrier.h"
+
+#include <utility>
+
+#include "sky/cpu.hpp"
+#include "sky/futex.h"
+
+using namespace std;
+using namespace sky;
+
+namespace {
+
+enum { SLEEPING = 1, ONE = 2 };
+
+int phase_of(int value)
+{
+    return value & ~SLEEPING;
+}
+
+} // namespace
+
+barrier::barrier(int expected, function<void()> completion) :
+    remaining(expected),
+    participants(expected),
+    phase(0),
+    completion(std::move(completion))
+{}
+
+barrier::arrival_token barrier::arrive()
+{
+    // The phase cannot end before we arrive, so this is still our phase.
+    arrival_token token = phase_of(phase.load(memory_order_relaxed));
+    if (remaining.fetch_sub(1, memory_order_acq_rel) == 1) {
+        complete_phase(token);
+    }
+    return token;
+}
+
+void barrier::wait(arrival_token token) const
+{
+    spin_wait spin;
+    while (!spin.yielding()) {
+        if (phase_of(phase.load(memory_order_acquire)) != token) return;
+        spin.wait();
+    }
+
+    int value = phase.load(memory_order_acquire);
+    while (phase_of(value) == token) {
+        if (!(value & SLEEPING)) {
+            // Tell the last thread to wake us, unless the phase just ended.
+            if (!phase.compare_exchange_weak(value, value | SLEEPING,
+                                             memory_order_acquire)) {
+                continue;
+            }
+            value |= SLEEPING;
+        }
+        futex_wait(phase, value);
+        value = phase.load(memory_order_acquire);
+    }
+}
+
+void barrier::arrive_and_wait()
+{
+    wait(arrive());
+}
+
+void barrier::arrive_and_drop()
+{
+    participants.fetch_sub(1, memory_order_relaxed);
+    arrive();
+}
+
+void barrier::complete_phase(arrival_token token)
+{
+    if (completion) completion();
+    remaining.store(participants.load(memory_order_relaxed),
+                    memory_order_relaxed);
+
+    // Wraps around through unsigned arithmetic, which cannot overflow.
+    int next = int(unsigned(token) + ONE);
+    int old = phase.exchange(next, memory_order_acq_rel);
+    if (old & SLEEPING) futex_wake_all(phase);
+}
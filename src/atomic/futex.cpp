@@ -0,0 +1,122 @@
+#include "sky/futex.h"
+
+#include <climits>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#endif
+
+using namespace std;
+using namespace sky;
+
+static_assert(sizeof(atomic<int>) == sizeof(int),
+              "A futex word must be a plain int.");
+
+#if defined(__linux__)
+
+namespace {
+
+long futex(atomic<int> &word, int op, int value,
+           timespec const *timeout = nullptr)
+{
+    return syscall(SYS_futex, reinterpret_cast<int *>(&word), op, value,
+                   timeout, nullptr, 0);
+}
+
+} // namespace
+
+void sky::futex_wait(atomic<int> &word, int expected) noexcept
+{
+    /*
+     * EAGAIN means that the word changed, and EINTR that a signal arrived;
+     * either way the caller checks the word again.
+     */
+    futex(word, FUTEX_WAIT_PRIVATE, expected);
+}
+
+void sky::futex_wait_for(atomic<int> &word, int expected,
+                         chrono::nanoseconds timeout) noexcept
+{
+    if (timeout <= chrono::nanoseconds::zero()) return;
+    auto seconds = chrono::duration_cast<chrono::seconds>(timeout);
+    timespec relative;
+    relative.tv_sec = seconds.count();
+    relative.tv_nsec = (timeout - seconds).count();
+    // ETIMEDOUT is reported as any other early return.
+    futex(word, FUTEX_WAIT_PRIVATE, expected, &relative);
+}
+
+void sky::futex_wake(atomic<int> &word, int count) noexcept
+{
+    futex(word, FUTEX_WAKE_PRIVATE, count);
+}
+
+void sky::futex_wake_all(atomic<int> &word) noexcept
+{
+    futex(word, FUTEX_WAKE_PRIVATE, INT_MAX);
+}
+
+#else
+
+namespace {
+
+/*
+ * Waiters sleep on one of a fixed set of condition variables, picked by the
+ * address of their word. Words that share a bucket merely wake each other
+ * spuriously.
+ */
+struct bucket
+{
+    mutex lock;
+    condition_variable wake;
+};
+
+enum { BUCKET_COUNT = 64 };
+
+bucket &bucket_of(atomic<int> &word)
+{
+    static bucket buckets[BUCKET_COUNT];
+    uintptr_t address = reinterpret_cast<uintptr_t>(&word);
+    return buckets[(address / sizeof(int)) % BUCKET_COUNT];
+}
+
+} // namespace
+
+void sky::futex_wait(atomic<int> &word, int expected) noexcept
+{
+    bucket &b = bucket_of(word);
+    unique_lock<mutex> lock(b.lock);
+    if (word.load(memory_order_relaxed) == expected) b.wake.wait(lock);
+}
+
+void sky::futex_wait_for(atomic<int> &word, int expected,
+                         chrono::nanoseconds timeout) noexcept
+{
+    bucket &b = bucket_of(word);
+    unique_lock<mutex> lock(b.lock);
+    if (word.load(memory_order_relaxed) == expected) {
+        b.wake.wait_for(lock, timeout);
+    }
+}
+
+void sky::futex_wake(atomic<int> &word, int) noexcept
+{
+    // The bucket may be shared, so waking fewer than all could miss ours.
+    futex_wake_all(word);
+}
+
+void sky::futex_wake_all(atomic<int> &word) noexcept
+{
+    bucket &b = bucket_of(word);
+    lock_guard<mutex> lock(b.lock);
+    b.wake.notify_all();
+}
+
+#endif
@@ -0,0 +1,57 @@
+#include "sky/latch.h"
+
+#include "sky/cpu.hpp"
+#include "sky/futex.h"
+
+using namespace std;
+using namespace sky;
+
+namespace {
+
+enum { SLEEPING = 1, ONE = 2 };
+
+} // namespace
+
+latch::latch(int expected) :
+    state(expected * ONE)
+{}
+
+void latch::count_down(int n)
+{
+    int old = state.fetch_sub(n * ONE, memory_order_release);
+    if (old / ONE == n && (old & SLEEPING)) futex_wake_all(state);
+}
+
+bool latch::try_wait() const noexcept
+{
+    return state.load(memory_order_acquire) / ONE == 0;
+}
+
+void latch::wait() const
+{
+    spin_wait spin;
+    while (!spin.yielding()) {
+        if (try_wait()) return;
+        spin.wait();
+    }
+
+    int value = state.load(memory_order_acquire);
+    while (value / ONE != 0) {
+        if (!(value & SLEEPING)) {
+            // Tell count_down() to wake us, unless the count just changed.
+            if (!state.compare_exchange_weak(value, value | SLEEPING,
+                                             memory_order_acquire)) {
+                continue;
+            }
+            value |= SLEEPING;
+        }
+        futex_wait(state, value);
+        value = state.load(memory_order_acquire);
+    }
+}
+
+void latch::arrive_and_wait(int n)
+{
+    count_down(n);
+    wait();
+}
@@ -0,0 +1,103 @@
+#include "sky/rw_lock.h"
+
+#include <thread>
+
+#include "sky/futex.h"
+
+using namespace std;
+using namespace sky;
+
+namespace {
+
+// The flag is never SLEEPING without WRITER, so 0 means no writer.
+enum { WRITER = 1, SLEEPING = 2 };
+
+size_t default_slots(size_t slots)
+{
+    if (slots) return slots;
+    unsigned cores = thread::hardware_concurrency();
+    return cores ? cores : 1;
+}
+
+} // namespace
+
+rw_lock::rw_lock(size_t slots) :
+    nslots(default_slots(slots)),
+    writer(0)
+{
+    this->slots.reset(new slot[nslots]);
+}
+
+void rw_lock::lock()
+{
+    int value = writer.load(memory_order_relaxed);
+    for (;;) {
+        if (!(value & WRITER)) {
+            if (writer.compare_exchange_weak(value, value | WRITER,
+                                             memory_order_seq_cst,
+                                             memory_order_relaxed)) {
+                break;
+            }
+            continue;
+        }
+        wait_for_writer();
+        value = writer.load(memory_order_relaxed);
+    }
+    wait_for_readers();
+}
+
+bool rw_lock::try_lock()
+{
+    int expected = 0;
+    if (!writer.compare_exchange_strong(expected, WRITER,
+                                        memory_order_seq_cst,
+                                        memory_order_relaxed)) {
+        return false;
+    }
+    for (size_t i = 0; i < nslots; ++i) {
+        if (slots[i].readers.load(memory_order_seq_cst) != 0) {
+            unlock();
+            return false;
+        }
+    }
+    return true;
+}
+
+void rw_lock::unlock()
+{
+    if (writer.exchange(0, memory_order_release) & SLEEPING) {
+        futex_wake_all(writer);
+    }
+}
+
+void rw_lock::wait_for_writer()
+{
+    spin_wait spin;
+    while (!spin.yielding()) {
+        if (writer.load(memory_order_acquire) == 0) return;
+        spin.wait();
+    }
+
+    int value = writer.load(memory_order_acquire);
+    while (value & WRITER) {
+        if (!(value & SLEEPING)) {
+            // Tell unlock() to wake us, unless the writer just left.
+            if (!writer.compare_exchange_weak(value, value | SLEEPING,
+                                              memory_order_acquire)) {
+                continue;
+            }
+            value |= SLEEPING;
+        }
+        futex_wait(writer, value);
+        value = writer.load(memory_order_acquire);
+    }
+}
+
+void rw_lock::wait_for_readers()
+{
+    // New readers back off as soon as they see our flag.
+    for (size_t i = 0; i < nslots; ++i) {
+        spin_wait spin;
+        while (slots[i].readers.load(memory_order_seq_cst) != 0) spin.wait();
+    }
+}
@@ -1,20 +1,32 @@
 #include "sky/semaphore.h"
 
+#include "sky/futex.h"
+
 using namespace std;
 using namespace sky;
 
 semaphore::semaphore(int resources) :
     resource_pool(resources),
-    released(resources < 0? resources : 0)
+    waiters(0),
+    bulk_waiters(0)
 {}
 
 bool semaphore::try_acquire()
 {
-    unique_lock<mutex> lock(resource_mutex, defer_lock_t());
-    if (!lock.try_lock()) return false;
-    if (resource_pool < 1) return false;
-    resource_pool -= 1;
-    return true;
+    return try_acquire(1);
+}
+
+bool semaphore::try_acquire(int n)
+{
+    int available = resource_pool.load(memory_order_relaxed);
+    while (available >= n) {
+        if (resource_pool.compare_exchange_weak(available, available - n,
+                                                memory_order_acquire,
+                                                memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 bool semaphore::try_P()
@@ -29,19 +41,13 @@ bool semaphore::try_lock()
 
 void semaphore::acquire()
 {
-    unique_lock<mutex> lock(resource_mutex);
-
-    /*
-     * If there are available resources, acquire one.
-     * Otherwise, wait for a resource to be released and
-     * acquire the released resource immediately.
-     */
+    acquire(1);
+}
 
-    if ((resource_pool--) > 0) return;
-    do {
-        resource_available.wait(lock);
-    } while (released < 1);
-    --released;
+void semaphore::acquire(int n)
+{
+    if (try_acquire(n)) return;
+    wait_for_resources(n, nullptr);
 }
 
 void semaphore::P()
@@ -56,18 +62,25 @@ void semaphore::lock()
 
 void semaphore::release()
 {
-    lock_guard<mutex> lock(resource_mutex);
+    release(1);
+}
 
+void semaphore::release(int n)
+{
     /*
-     * If there are no waiters, just release the resource into
-     * the pool. Otherwise, notify a waiting thread of the
-     * released resource.
+     * Pairs with wait_for_resources(): either the waiter sees the new
+     * resources before it sleeps, or we see the waiter and wake it.
      */
-
-    if ((resource_pool++) > -1) return;
-    ++released;
-    if (released > 0)
-        resource_available.notify_one();
+    resource_pool.fetch_add(n, memory_order_seq_cst);
+    if (bulk_waiters.load(memory_order_seq_cst) > 0) {
+        /*
+         * The first waiters in line may need more than we released, while
+         * others behind them need less, so let them all check.
+         */
+        futex_wake_all(resource_pool);
+    } else if (waiters.load(memory_order_seq_cst) > 0) {
+        futex_wake(resource_pool, n);
+    }
 }
 
 void semaphore::V()
@@ -80,4 +93,34 @@ void semaphore::unlock()
     release();
 }
 
-
+bool semaphore::wait_for_resources(int n, clock::time_point const* deadline)
+{
+    atomic<int> &sleepers = n == 1 ? waiters : bulk_waiters;
+    sleepers.fetch_add(1, memory_order_seq_cst);
+
+    bool acquired = false;
+    for (;;) {
+        int available = resource_pool.load(memory_order_seq_cst);
+        if (available >= n) {
+            if (resource_pool.compare_exchange_weak(available, available - n,
+                                                    memory_order_acquire,
+                                                    memory_order_relaxed)) {
+                acquired = true;
+                break;
+            }
+            continue;
+        }
+
+        // Sleeps only if no resource was released since the load.
+        if (!deadline) {
+            futex_wait(resource_pool, available);
+            continue;
+        }
+        clock::time_point now = clock::now();
+        if (now >= *deadline) break;
+        futex_wait_for(resource_pool, available, *deadline - now);
+    }
+
+    sleepers.fetch_sub(1, memory_order_relaxed);
+    return acquired;
+}
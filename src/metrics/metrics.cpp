@@ -0,0 +1,196 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "sky/metrics.h"
+
+using namespace std;
+using namespace sky;
+
+namespace {
+
+// Enough room for any integer or double printed by the exporter.
+enum { VALUE_WIDTH = 32 };
+
+char const *const quantiles[] = {"0.5", "0.9", "0.99", "0.999"};
+double const percents[] = {50, 90, 99, 99.9};
+enum { QUANTILE_COUNT = sizeof(percents) / sizeof(percents[0]) };
+
+bool valid_name(string const& name)
+{
+    if (name.empty()) return false;
+    for (size_t i = 0; i < name.size(); ++i) {
+        char c = name[i];
+        bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                  || c == '_' || c == ':';
+        bool digit = c >= '0' && c <= '9';
+        if (!alpha && !(digit && i > 0)) return false;
+    }
+    return true;
+}
+
+string escape_help(string const& help)
+{
+    string escaped;
+    escaped.reserve(help.size());
+    for (char c : help) {
+        if (c == '\\') {
+            escaped += "\\\\";
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+char *append(char *buf, string const& s)
+{
+    memcpy(buf, s.data(), s.size());
+    return buf + s.size();
+}
+
+} // namespace
+
+metrics_registry::metrics_registry() :
+    buffer(1)
+{}
+
+size_t metrics_registry::size() const noexcept
+{
+    lock_guard<mutex> lock(export_mutex);
+    return metrics.size();
+}
+
+void metrics_registry::add_metric(metric m, string const& help,
+                                  char const *type)
+{
+    if (!valid_name(m.name)) {
+        throw invalid_argument("metrics_registry: Invalid metric name.");
+    }
+
+    // An export may be formatting into the buffer that we are about to grow.
+    lock_guard<mutex> lock(export_mutex);
+    for (metric const& other : metrics) {
+        if (other.name == m.name) {
+            throw invalid_argument("metrics_registry: Duplicate metric name.");
+        }
+    }
+
+    m.header = "# HELP " + m.name + " " + escape_help(help) + "\n"
+             + "# TYPE " + m.name + " " + type + "\n";
+
+    // The longest text this metric can ever be formatted as.
+    size_t line = m.name.size() + VALUE_WIDTH + 2;
+    size_t bound = m.header.size();
+    if (m.kind == counter_kind) {
+        bound += line;
+    } else {
+        bound += QUANTILE_COUNT * (line + strlen("{quantile=\"0.999\"}"))
+               + line + strlen("_sum")
+               + line + strlen("_count");
+    }
+
+    metrics.reserve(metrics.size() + 1);
+    buffer.resize(buffer.size() + bound);
+    metrics.push_back(std::move(m));
+}
+
+char const *metrics_registry::format(size_t &length)
+{
+    lock_guard<mutex> lock(export_mutex);
+    length = format_locked();
+    return buffer.data();
+}
+
+size_t metrics_registry::export_to(output out)
+{
+    lock_guard<mutex> lock(export_mutex);
+    size_t length = format_locked();
+
+    size_t written = 0;
+    while (written < length) {
+        size_t n = out.write(buffer.data() + written, length - written);
+        if (n == 0) break;
+        written += n;
+    }
+    return written;
+}
+
+size_t metrics_registry::format_locked()
+{
+    char *buf = buffer.data();
+    size_t length = 0;
+    for (metric const& m : metrics) {
+        if (m.kind == counter_kind) {
+            length += format_counter(m, buf + length);
+        } else {
+            length += format_histogram(m, buf + length);
+        }
+    }
+    return length;
+}
+
+size_t metrics_registry::format_counter(metric const& m, char *buf)
+{
+    char *p = append(buf, m.header);
+    p = append(p, m.name);
+    *p++ = ' ';
+    p += m.print(m.source, p, VALUE_WIDTH + 1);
+    *p++ = '\n';
+    return p - buf;
+}
+
+size_t metrics_registry::format_histogram(metric const& m, char *buf)
+{
+    m.load(m.source, scratch);
+
+    char *p = append(buf, m.header);
+    for (size_t i = 0; i < QUANTILE_COUNT; ++i) {
+        p = append(p, m.name);
+        p += snprintf(p, VALUE_WIDTH + 20, "{quantile=\"%s\"} %llu\n",
+                      quantiles[i],
+                      (unsigned long long)scratch.percentile(percents[i]));
+    }
+    // An estimate from the bucket midpoints; the values are not kept.
+    p = append(p, m.name);
+    p += snprintf(p, VALUE_WIDTH + 6, "_sum %.17g\n",
+                  scratch.mean() * scratch.count());
+    p = append(p, m.name);
+    p += snprintf(p, VALUE_WIDTH + 8, "_count %llu\n",
+                  (unsigned long long)scratch.count());
+    return p - buf;
+}
+
+metrics_exporter::metrics_exporter(metrics_registry &registry, output out,
+                                   chrono::milliseconds period) :
+    registry(registry),
+    out(out),
+    period(period),
+    stopping(false),
+    thread(&metrics_exporter::run, this)
+{}
+
+metrics_exporter::~metrics_exporter()
+{
+    {
+        lock_guard<mutex> lock(stop_mutex);
+        stopping = true;
+    }
+    stop_signal.notify_one();
+    thread.join();
+}
+
+void metrics_exporter::run()
+{
+    unique_lock<mutex> lock(stop_mutex);
+    bool last = false;
+    while (!last) {
+        last = stop_signal.wait_for(lock, period, [this] { return stopping; });
+        try {
+            registry.export_to(out);
+        } catch (...) {
+            return;
+        }
+    }
+}
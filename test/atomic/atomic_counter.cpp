@@ -50,6 +50,17 @@ TYPED_TEST(AtomicCounter, ConstructInit_constexpr)
     expect_eq<TypeParam>(42, const_cast<atomic_counter<TypeParam>&>(t));
 }
 
+TYPED_TEST(AtomicCounter, Load_const)
+{
+    atomic_counter<TypeParam> t(23);
+    atomic_counter<TypeParam> const& reader = t;
+
+    ++t;
+
+    expect_eq<TypeParam>(24, reader.load());
+    expect_eq<TypeParam>(24, reader);
+}
+
 TYPED_TEST(AtomicCounter, IsLockFree)
 {
     std::atomic<TypeParam> variable;
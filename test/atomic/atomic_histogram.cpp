@@ -0,0 +1,179 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <sky/atomic_histogram.hpp>
+
+using namespace sky;
+
+TEST(AtomicHistogram, Empty)
+{
+    atomic_histogram<> h;
+    histogram_snapshot s = h.load();
+
+    EXPECT_EQ(0u, s.count());
+    EXPECT_EQ(0u, s.percentile(50));
+    EXPECT_EQ(0u, s.min());
+    EXPECT_EQ(0u, s.max());
+    EXPECT_EQ(0.0, s.mean());
+}
+
+TEST(AtomicHistogram, SmallValuesExact)
+{
+    atomic_histogram<> h;
+
+    for (std::uint64_t v = 0; v < 32; ++v) h.record(v);
+    histogram_snapshot s = h.load();
+
+    EXPECT_EQ(32u, s.count());
+    EXPECT_EQ(0u, s.min());
+    EXPECT_EQ(31u, s.max());
+    EXPECT_EQ(15u, s.percentile(50));
+    EXPECT_DOUBLE_EQ(15.5, s.mean());
+}
+
+TEST(AtomicHistogram, NearestRank)
+{
+    atomic_histogram<> h;
+
+    for (std::uint64_t v = 1; v <= 10; ++v) h.record(v);
+    histogram_snapshot s = h.load();
+
+    EXPECT_EQ(1u, s.percentile(0));
+    EXPECT_EQ(1u, s.percentile(10));
+    EXPECT_EQ(3u, s.percentile(21));
+    EXPECT_EQ(5u, s.percentile(50));
+    EXPECT_EQ(6u, s.percentile(51));
+    EXPECT_EQ(7u, s.percentile(70));
+    EXPECT_EQ(10u, s.percentile(91));
+    EXPECT_EQ(10u, s.percentile(100));
+}
+
+TEST(AtomicHistogram, NearestRank_TwoValues)
+{
+    atomic_histogram<> h;
+
+    h.record(1);
+    h.record(2);
+    histogram_snapshot s = h.load();
+
+    EXPECT_EQ(1u, s.percentile(50));
+    EXPECT_EQ(2u, s.percentile(50.1));
+    EXPECT_EQ(2u, s.percentile(99));
+}
+
+TEST(AtomicHistogram, RelativeError)
+{
+    std::mt19937_64 random(42);
+    for (int i = 0; i < 100000; ++i) {
+        std::uint64_t v = random() >> (random() % 64);
+        atomic_histogram<> h;
+        h.record(v);
+        std::uint64_t reported = h.load().max();
+        ASSERT_LE(v, reported);
+        ASSERT_LE(double(reported - v), double(v) / 32) << v;
+    }
+}
+
+TEST(AtomicHistogram, ExtremeValues)
+{
+    atomic_histogram<> h;
+
+    h.record(0);
+    h.record(~std::uint64_t(0));
+    histogram_snapshot s = h.load();
+
+    EXPECT_EQ(0u, s.min());
+    EXPECT_EQ(~std::uint64_t(0), s.max());
+}
+
+TEST(AtomicHistogram, Percentiles)
+{
+    atomic_histogram<> h;
+
+    for (std::uint64_t v = 1; v <= 10000; ++v) h.record(v);
+    histogram_snapshot s = h.load();
+
+    EXPECT_EQ(10000u, s.count());
+    auto near = [](double expected, std::uint64_t actual) {
+        EXPECT_LE(expected, double(actual));
+        EXPECT_GE(expected * (1 + 1.0 / 32), double(actual));
+    };
+    near(5000, s.percentile(50));
+    near(9900, s.percentile(99));
+    near(9990, s.percentile(99.9));
+    near(10000, s.percentile(100));
+    near(1, s.percentile(0));
+    EXPECT_NEAR(5000.5, s.mean(), 5000.5 / 32);
+}
+
+TEST(AtomicHistogram, RecordMany)
+{
+    atomic_histogram<> h;
+
+    h.record(100, 5);
+    h.record(std::chrono::microseconds(2));
+
+    histogram_snapshot s = h.load();
+    EXPECT_EQ(6u, s.count());
+    EXPECT_LE(2000u, s.max());
+}
+
+TEST(AtomicHistogram, Snapshot_Resets)
+{
+    atomic_histogram<4> h;
+
+    h.record(10);
+    h.record(20);
+    histogram_snapshot first = h.snapshot();
+    EXPECT_EQ(2u, first.count());
+    EXPECT_EQ(0u, h.load().count());
+
+    h.record(30);
+    histogram_snapshot second = h.snapshot();
+    EXPECT_EQ(1u, second.count());
+    EXPECT_LE(30u, second.min());
+}
+
+TEST(AtomicHistogram, Merge)
+{
+    atomic_histogram<> a;
+    atomic_histogram<2> b;
+
+    for (std::uint64_t v = 1; v <= 100; ++v) a.record(v);
+    for (std::uint64_t v = 101; v <= 200; ++v) b.record(v);
+
+    histogram_snapshot s = a.load();
+    s += b.load();
+    EXPECT_EQ(200u, s.count());
+    EXPECT_EQ(1u, s.min());
+    EXPECT_LE(200u, s.max());
+    EXPECT_LE(100u, s.percentile(50));
+    EXPECT_GE(104u, s.percentile(50));
+}
+
+TEST(AtomicHistogram, ConcurrentRecording)
+{
+    const int threads = 4;
+    const int per_thread = 50000;
+    atomic_histogram<4> h;
+    std::vector<std::thread> workers;
+    std::vector<histogram_snapshot> taken;
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&h, t] {
+            for (int i = 0; i < per_thread; ++i) h.record(t * 1000 + i % 1000);
+        });
+    }
+    for (int i = 0; i < 10; ++i) taken.push_back(h.snapshot());
+    for (auto &w : workers) w.join();
+    taken.push_back(h.snapshot());
+
+    histogram_snapshot total;
+    for (auto const& s : taken) total += s;
+    EXPECT_EQ(std::uint64_t(threads) * per_thread, total.count());
+    EXPECT_EQ(0u, total.min());
+}
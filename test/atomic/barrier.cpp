@@ -0,0 +1,109 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "sky/barrier.h"
+
+using sky::barrier;
+
+TEST(Barrier, SingleParticipant)
+{
+    unsigned completions = 0;
+    barrier b(1, [&] { ++completions; });
+
+    b.arrive_and_wait();
+    b.arrive_and_wait();
+    EXPECT_EQ(2u, completions);
+}
+
+TEST(Barrier, ArriveAndWaitToken)
+{
+    barrier b(2);
+
+    barrier::arrival_token token = b.arrive();
+    std::thread other([&] { b.arrive_and_wait(); });
+    b.wait(token);
+    other.join();
+}
+
+TEST(Barrier, PhasesStayInStep)
+{
+    const unsigned threads = 4;
+    const unsigned phases = 1000;
+    std::atomic<unsigned> arrived(0);
+    std::atomic<bool> out_of_step(false);
+    unsigned completions = 0;
+    barrier b(threads, [&] {
+        // Every thread has arrived, and none has left yet.
+        if (arrived.load() != threads * (completions + 1)) out_of_step = true;
+        ++completions;
+    });
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (unsigned p = 0; p < phases; ++p) {
+                ++arrived;
+                b.arrive_and_wait();
+                if (arrived.load() < threads * (p + 1)) out_of_step = true;
+            }
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    EXPECT_FALSE(out_of_step);
+    EXPECT_EQ(phases, completions);
+}
+
+TEST(Barrier, CompletionSeesAllWork)
+{
+    const unsigned threads = 4;
+    std::vector<int> slots(threads, 0);
+    int total = 0;
+    barrier b(threads, [&] {
+        for (int s : slots) total += s;
+    });
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            slots[t] = 1;
+            b.arrive_and_wait();
+        });
+    }
+    for (auto &w : workers) w.join();
+    EXPECT_EQ(int(threads), total);
+}
+
+TEST(Barrier, ArriveAndDrop)
+{
+    std::atomic<unsigned> completions(0);
+    barrier b(3, [&] { ++completions; });
+
+    std::thread dropper([&] { b.arrive_and_drop(); });
+    std::thread worker([&] {
+        b.arrive_and_wait();
+        b.arrive_and_wait();
+    });
+    b.arrive_and_wait();
+    // The next phase only waits for this thread and the worker.
+    b.arrive_and_wait();
+    dropper.join();
+    worker.join();
+    EXPECT_EQ(2u, completions.load());
+}
+
+TEST(Barrier, SleepersAreWoken)
+{
+    barrier b(2);
+
+    std::thread late([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        b.arrive_and_wait();
+    });
+    b.arrive_and_wait();
+    late.join();
+}
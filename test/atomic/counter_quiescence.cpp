@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <sky/atomic.hpp>
+
+using namespace sky;
+
+TEST(CounterQuiescence, ConstructDefault_Zero)
+{
+    atomic_counter<int> single;
+    atomic_counter<int, 4> striped;
+
+    EXPECT_EQ(0, single.load());
+    EXPECT_EQ(0, striped.load());
+}
+
+TEST(CounterQuiescence, WaitQuiescent_NoWriters)
+{
+    atomic_counter<long> single(1);
+    atomic_counter<long, 4> striped(2);
+
+    single.wait_quiescent();
+    striped.wait_quiescent();
+    EXPECT_EQ(1, single.load());
+    EXPECT_EQ(2, striped.load());
+}
+
+TEST(CounterQuiescence, WaitQuiescent_WaitsForWriter)
+{
+    atomic_counter<long, 4> counter(0);
+    std::atomic<bool> registered(false);
+    std::atomic<bool> finished(false);
+
+    std::thread writer([&] {
+        atomic_counter<long, 4>::writer w(counter);
+        registered = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        counter += 5;
+        finished = true;
+    });
+    while (!registered) std::this_thread::yield();
+
+    counter.wait_quiescent();
+    EXPECT_TRUE(finished.load());
+    EXPECT_EQ(5, counter.load());
+    writer.join();
+}
+
+TEST(CounterQuiescence, WaitQuiescent_ExactTotal)
+{
+    const int threads = 4;
+    const int batches = 100;
+    const int per_batch = 100;
+    atomic_counter<long, 8> counter(0);
+    std::atomic<int> started(0);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            atomic_counter<long, 8>::writer w(counter);
+            ++started;
+            for (int b = 0; b < batches * per_batch; ++b) ++counter;
+        });
+    }
+    while (started.load() < threads) std::this_thread::yield();
+
+    counter.wait_quiescent();
+    EXPECT_EQ(long(threads) * batches * per_batch, counter.load());
+    for (auto &w : workers) w.join();
+}
+
+TEST(CounterQuiescence, Snapshot_Delta)
+{
+    atomic_counter<int, 4> counter(3);
+    int last = 0;
+
+    counter += 4;
+    EXPECT_EQ(7, counter.snapshot(last));
+    EXPECT_EQ(7, last);
+    ++counter;
+    EXPECT_EQ(1, counter.snapshot(last));
+    EXPECT_EQ(0, counter.snapshot(last));
+}
+
+TEST(CounterQuiescence, Snapshot_KeepsTotal)
+{
+    atomic_counter<int, 4> counter(3);
+    int first = 0, second = 0;
+
+    counter += 4;
+    EXPECT_EQ(7, counter.snapshot(first));
+    EXPECT_EQ(7, counter.load());
+    // Every reader keeps its own baseline.
+    EXPECT_EQ(7, counter.snapshot(second));
+    --counter;
+    EXPECT_EQ(-1, counter.snapshot(first));
+    EXPECT_EQ(6, counter.load());
+}
+
+TEST(CounterQuiescence, Snapshot_volatile)
+{
+    volatile atomic_counter<int> counter(3);
+    int last = 1;
+
+    counter += 2;
+    EXPECT_EQ(4, counter.snapshot(last));
+    counter.wait_quiescent();
+}
+
+TEST(CounterQuiescence, Snapshot_NoLostUpdates)
+{
+    const int threads = 4;
+    const int per_thread = 100000;
+    atomic_counter<long, 4> counter(0);
+    std::atomic<int> running(threads);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (int i = 0; i < per_thread; ++i) ++counter;
+            --running;
+        });
+    }
+
+    long total = 0, last = 0;
+    while (running.load() > 0) total += counter.snapshot(last);
+    for (auto &w : workers) w.join();
+    total += counter.snapshot(last);
+
+    EXPECT_EQ(long(threads) * per_thread, total);
+}
@@ -0,0 +1,89 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "sky/latch.h"
+
+using sky::latch;
+
+TEST(Latch, ZeroIsOpen)
+{
+    latch l(0);
+
+    EXPECT_TRUE(l.try_wait());
+    l.wait();
+}
+
+TEST(Latch, CountDown)
+{
+    latch l(3);
+
+    l.count_down();
+    EXPECT_FALSE(l.try_wait());
+    l.count_down(2);
+    EXPECT_TRUE(l.try_wait());
+    l.wait();
+}
+
+TEST(Latch, ArriveAndWaitLast)
+{
+    latch l(2);
+
+    l.count_down();
+    l.arrive_and_wait();
+    EXPECT_TRUE(l.try_wait());
+}
+
+TEST(Latch, ReleasesAllWaiters)
+{
+    const unsigned threads = 4;
+    latch l(1);
+    std::atomic<unsigned> released(0);
+
+    std::vector<std::thread> waiters;
+    for (unsigned t = 0; t < threads; ++t) {
+        waiters.emplace_back([&] {
+            l.wait();
+            ++released;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(0u, released.load());
+
+    l.count_down();
+    for (auto &w : waiters) w.join();
+    EXPECT_EQ(threads, released.load());
+}
+
+TEST(Latch, JoinsWorkers)
+{
+    const unsigned threads = 8;
+    latch done(threads);
+    std::vector<int> results(threads, 0);
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            results[t] = int(t) + 1;
+            done.count_down();
+        });
+    }
+    done.wait();
+    for (unsigned t = 0; t < threads; ++t) EXPECT_EQ(int(t) + 1, results[t]);
+    for (auto &w : workers) w.join();
+}
+
+TEST(Latch, DestroyedByWaiter)
+{
+    // The last count_down() must not touch the latch after waking the waiter.
+    for (unsigned i = 0; i < 100; ++i) {
+        latch *l = new latch(1);
+        std::thread counter([l] { l->count_down(); });
+        l->wait();
+        delete l;
+        counter.join();
+    }
+}
@@ -0,0 +1,144 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sky/rw_lock.h"
+
+using sky::rw_lock;
+
+TEST(RwLock, SlotCount)
+{
+    EXPECT_EQ(4u, rw_lock(4).slot_count());
+    EXPECT_LE(1u, rw_lock().slot_count());
+}
+
+TEST(RwLock, UsableWithLockGuard)
+{
+    rw_lock lock;
+    std::lock_guard<rw_lock> guard(lock);
+}
+
+TEST(RwLock, ReadersShare)
+{
+    rw_lock lock;
+
+    lock.lock_shared();
+    EXPECT_TRUE(lock.try_lock_shared());
+    EXPECT_FALSE(lock.try_lock());
+    lock.unlock_shared();
+    EXPECT_FALSE(lock.try_lock());
+    lock.unlock_shared();
+    EXPECT_TRUE(lock.try_lock());
+    lock.unlock();
+}
+
+TEST(RwLock, WriterExcludes)
+{
+    rw_lock lock;
+
+    lock.lock();
+    EXPECT_FALSE(lock.try_lock());
+    EXPECT_FALSE(lock.try_lock_shared());
+    lock.unlock();
+    EXPECT_TRUE(lock.try_lock_shared());
+    lock.unlock_shared();
+}
+
+TEST(RwLock, ReadersInOtherThreadsShare)
+{
+    const unsigned threads = 4;
+    rw_lock lock(2);
+    std::atomic<unsigned> inside(0);
+
+    std::vector<std::thread> readers;
+    for (unsigned t = 0; t < threads; ++t) {
+        readers.emplace_back([&] {
+            lock.lock_shared();
+            ++inside;
+            // Every reader gets in while the others hold the lock.
+            while (inside.load() < threads) std::this_thread::yield();
+            lock.unlock_shared();
+        });
+    }
+    for (auto &r : readers) r.join();
+    EXPECT_EQ(threads, inside.load());
+}
+
+TEST(RwLock, WriterWaitsForReaders)
+{
+    rw_lock lock;
+    std::atomic<bool> written(false);
+
+    lock.lock_shared();
+    std::thread writer([&] {
+        lock.lock();
+        written = true;
+        lock.unlock();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(written);
+
+    lock.unlock_shared();
+    writer.join();
+    EXPECT_TRUE(written);
+}
+
+TEST(RwLock, ReaderWaitsForWriter)
+{
+    rw_lock lock;
+    std::atomic<bool> read(false);
+
+    lock.lock();
+    std::thread reader([&] {
+        lock.lock_shared();
+        read = true;
+        lock.unlock_shared();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(read);
+
+    lock.unlock();
+    reader.join();
+    EXPECT_TRUE(read);
+}
+
+TEST(RwLock, ReadersSeeConsistentWrites)
+{
+    const unsigned readers = 3;
+    const unsigned writers = 2;
+    const unsigned iterations = 5000;
+    rw_lock lock(2);
+    // Written together under the lock, so readers must see them equal.
+    unsigned long first = 0;
+    unsigned long second = 0;
+    std::atomic<bool> torn(false);
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < writers; ++t) {
+        threads.emplace_back([&] {
+            for (unsigned i = 0; i < iterations; ++i) {
+                std::lock_guard<rw_lock> guard(lock);
+                ++first;
+                ++second;
+            }
+        });
+    }
+    for (unsigned t = 0; t < readers; ++t) {
+        threads.emplace_back([&] {
+            for (unsigned i = 0; i < iterations; ++i) {
+                lock.lock_shared();
+                if (first != second) torn = true;
+                lock.unlock_shared();
+            }
+        });
+    }
+    for (auto &t : threads) t.join();
+
+    EXPECT_FALSE(torn);
+    EXPECT_EQ(writers * iterations, first);
+    EXPECT_EQ(writers * iterations, second);
+}
@@ -1,6 +1,12 @@
 #include "gtest/gtest.h"
 #include "../interface_tests.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "sky/semaphore.h"
 
 // Interface tests
@@ -38,12 +44,20 @@ TEST(Semaphore, UsableWithUniqueLock)
     EXPECT_TRUE(lock.try_lock());
 }
 
+TEST(Semaphore, UsableWithTimedUniqueLock)
+{
+    sky::semaphore s;
+    std::unique_lock<sky::semaphore> lock(s, std::defer_lock_t());
+
+    EXPECT_TRUE(lock.try_lock_for(std::chrono::milliseconds(1)));
+    lock.unlock();
+    EXPECT_TRUE(lock.try_lock_until(
+            std::chrono::steady_clock::now() + std::chrono::milliseconds(1)));
+}
+
 TEST(Semaphore, SizeOf)
 {
-    size_t expected
-            = sizeof(std::mutex)
-            + sizeof(std::condition_variable)
-            + 2*sizeof(int);
+    size_t expected = 3*sizeof(std::atomic<int>);
 
     EXPECT_EQ(expected, sizeof(sky::semaphore));
 }
@@ -133,3 +147,239 @@ TEST(Semaphore, V)
 
     EXPECT_TRUE(s.try_acquire());
 }
+
+TEST(Semaphore, ReleaseWakesWaiter)
+{
+    semaphore s(0);
+    std::atomic<bool> acquired(false);
+
+    std::thread waiter([&] {
+        s.acquire();
+        acquired = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(acquired);
+
+    s.release();
+    waiter.join();
+    EXPECT_TRUE(acquired);
+    EXPECT_FALSE(s.try_acquire());
+}
+
+TEST(Semaphore, PaysOffDebtBeforeWaking)
+{
+    semaphore s(-1);
+    std::atomic<bool> acquired(false);
+
+    std::thread waiter([&] {
+        s.acquire();
+        acquired = true;
+    });
+    s.release();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(acquired);
+
+    s.release();
+    waiter.join();
+    EXPECT_TRUE(acquired);
+}
+
+TEST(Semaphore, MutualExclusion)
+{
+    const unsigned threads = 4;
+    const unsigned iterations = 10000;
+    semaphore s(1);
+    unsigned long total = 0;
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (unsigned i = 0; i < iterations; ++i) {
+                std::lock_guard<semaphore> lock(s);
+                ++total;
+            }
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    EXPECT_EQ(threads * iterations, total);
+    EXPECT_TRUE(s.try_acquire());
+    EXPECT_FALSE(s.try_acquire());
+}
+
+TEST(Semaphore, BoundsConcurrency)
+{
+    const int resources = 3;
+    const unsigned threads = 8;
+    semaphore s(resources);
+    std::atomic<int> inside(0);
+    std::atomic<int> most(0);
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (unsigned i = 0; i < 1000; ++i) {
+                s.acquire();
+                int now = ++inside;
+                int seen = most.load();
+                while (now > seen && !most.compare_exchange_weak(seen, now)) {}
+                std::this_thread::yield();
+                --inside;
+                s.release();
+            }
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    EXPECT_LE(most.load(), resources);
+    for (int i = 0; i < resources; ++i) EXPECT_TRUE(s.try_acquire());
+    EXPECT_FALSE(s.try_acquire());
+}
+
+TEST(Semaphore, TryAcquireMany)
+{
+    semaphore s(5);
+
+    EXPECT_FALSE(s.try_acquire(6));
+    EXPECT_TRUE(s.try_acquire(3));
+    // All or nothing: two are left, so taking three takes none.
+    EXPECT_FALSE(s.try_acquire(3));
+    EXPECT_TRUE(s.try_acquire(2));
+    EXPECT_FALSE(s.try_acquire());
+}
+
+TEST(Semaphore, AcquireAndReleaseMany)
+{
+    semaphore s(4);
+
+    s.acquire(4);
+    EXPECT_FALSE(s.try_acquire());
+    s.release(3);
+    EXPECT_TRUE(s.try_acquire(3));
+    EXPECT_FALSE(s.try_acquire());
+}
+
+TEST(Semaphore, TryAcquireForTimesOut)
+{
+    semaphore s(0);
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(s.try_acquire_for(std::chrono::milliseconds(20)));
+    EXPECT_GE(std::chrono::steady_clock::now() - start,
+              std::chrono::milliseconds(20));
+}
+
+TEST(Semaphore, TryAcquireForSucceedsImmediately)
+{
+    semaphore s(2);
+
+    EXPECT_TRUE(s.try_acquire_for(std::chrono::seconds(0), 2));
+    EXPECT_FALSE(s.try_acquire());
+}
+
+TEST(Semaphore, TryAcquireForWakesOnRelease)
+{
+    semaphore s(0);
+
+    std::thread releaser([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        s.release(2);
+    });
+    EXPECT_TRUE(s.try_acquire_for(std::chrono::seconds(10), 2));
+    releaser.join();
+    EXPECT_FALSE(s.try_acquire());
+}
+
+TEST(Semaphore, TryAcquireUntilOtherClock)
+{
+    semaphore s(0);
+
+    EXPECT_FALSE(s.try_acquire_until(
+            std::chrono::system_clock::now() + std::chrono::milliseconds(5)));
+    s.release();
+    EXPECT_TRUE(s.try_acquire_until(std::chrono::system_clock::now()));
+}
+
+TEST(Semaphore, ReleaseManyWakesManyWaiters)
+{
+    const unsigned threads = 4;
+    semaphore s(0);
+    std::atomic<unsigned> acquired(0);
+
+    std::vector<std::thread> waiters;
+    for (unsigned t = 0; t < threads; ++t) {
+        waiters.emplace_back([&] {
+            s.acquire();
+            ++acquired;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_EQ(0u, acquired.load());
+
+    s.release(threads);
+    for (auto &w : waiters) w.join();
+    EXPECT_EQ(threads, acquired.load());
+    EXPECT_FALSE(s.try_acquire());
+}
+
+TEST(Semaphore, SmallRequestsPassLargeOnes)
+{
+    semaphore s(0);
+    std::atomic<bool> large(false);
+    std::atomic<bool> small(false);
+
+    std::thread large_waiter([&] {
+        s.acquire(3);
+        large = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::thread small_waiter([&] {
+        s.acquire();
+        small = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    // Not enough for the large request, but enough for the small one.
+    s.release(1);
+    small_waiter.join();
+    EXPECT_TRUE(small);
+    EXPECT_FALSE(large);
+
+    s.release(3);
+    large_waiter.join();
+    EXPECT_TRUE(large);
+    EXPECT_FALSE(s.try_acquire());
+}
+
+TEST(Semaphore, BudgetIsNeverOverdrawn)
+{
+    const int budget = 10;
+    const unsigned threads = 6;
+    semaphore s(budget);
+    std::atomic<int> in_use(0);
+    std::atomic<bool> overdrawn(false);
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            int n = 1 + int(t % 4);
+            for (unsigned i = 0; i < 500; ++i) {
+                if (i % 2) {
+                    s.acquire(n);
+                } else if (!s.try_acquire_for(std::chrono::milliseconds(1),
+                                              n)) {
+                    continue;
+                }
+                if ((in_use += n) > budget) overdrawn = true;
+                std::this_thread::yield();
+                in_use -= n;
+                s.release(n);
+            }
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    EXPECT_FALSE(overdrawn);
+    EXPECT_TRUE(s.try_acquire(budget));
+    EXPECT_FALSE(s.try_acquire());
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <sky/seqlock.hpp>
+
+using namespace sky;
+
+namespace {
+
+// Larger than a word, and with a size that is not a multiple of one.
+struct snapshot
+{
+    std::uint64_t a;
+    std::uint64_t b;
+    std::uint32_t c;
+    char d;
+};
+
+snapshot make_snapshot(std::uint64_t n)
+{
+    snapshot s = {n, n, std::uint32_t(n), char(n)};
+    return s;
+}
+
+bool consistent(snapshot const& s)
+{
+    return s.a == s.b && std::uint32_t(s.a) == s.c && char(s.a) == s.d;
+}
+
+} // namespace
+
+TEST(Seqlock, TypeTraits)
+{
+    using namespace std;
+
+    EXPECT_TRUE (is_nothrow_default_constructible<seqlock<int>>::value);
+    EXPECT_FALSE(is_copy_constructible<seqlock<int>>::value);
+    EXPECT_FALSE(is_copy_assignable<seqlock<int>>::value);
+}
+
+TEST(Seqlock, DefaultConstruct)
+{
+    seqlock<int> value;
+    EXPECT_EQ(0, value.load());
+}
+
+TEST(Seqlock, Construct)
+{
+    seqlock<double> value(1.5);
+    EXPECT_EQ(1.5, value.load());
+}
+
+TEST(Seqlock, StoreLoad)
+{
+    seqlock<snapshot> value;
+
+    value.store(make_snapshot(7));
+    snapshot s = value.load();
+    EXPECT_TRUE(consistent(s));
+    EXPECT_EQ(7u, s.a);
+}
+
+TEST(Seqlock, TryLoad)
+{
+    seqlock<char> value('x');
+    char c = 0;
+
+    EXPECT_TRUE(value.try_load(c));
+    EXPECT_EQ('x', c);
+}
+
+TEST(Seqlock, ReadersNeverSeeTornValues)
+{
+    const unsigned readers = 3;
+    const std::uint64_t writes = 100000;
+    seqlock<snapshot> value(make_snapshot(0));
+    std::atomic<bool> done(false);
+    std::atomic<bool> torn(false);
+    std::atomic<bool> backwards(false);
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < readers; ++t) {
+        threads.emplace_back([&] {
+            std::uint64_t last = 0;
+            while (!done.load(std::memory_order_relaxed)) {
+                snapshot s = value.load();
+                if (!consistent(s)) torn = true;
+                if (s.a < last) backwards = true;
+                last = s.a;
+            }
+        });
+    }
+    for (std::uint64_t i = 1; i <= writes; ++i) value.store(make_snapshot(i));
+    done = true;
+    for (auto &t : threads) t.join();
+
+    EXPECT_FALSE(torn);
+    EXPECT_FALSE(backwards);
+    EXPECT_EQ(writes, value.load().a);
+}
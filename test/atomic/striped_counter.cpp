@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <sky/atomic.hpp>
+
+using namespace sky;
+
+template<typename T>
+class StripedCounter : public testing::Test {};
+
+typedef testing::Types<int, unsigned int, long> StripedIntegrals;
+
+TYPED_TEST_CASE(StripedCounter, StripedIntegrals);
+
+TYPED_TEST(StripedCounter, TypeTraits)
+{
+    using namespace std;
+    typedef atomic_counter<TypeParam, 8> counter_t;
+
+    EXPECT_TRUE (is_nothrow_default_constructible<counter_t>::value);
+    EXPECT_FALSE(is_copy_constructible<counter_t>::value);
+    EXPECT_FALSE(is_copy_assignable<counter_t>::value);
+}
+
+TYPED_TEST(StripedCounter, SizeOf)
+{
+    EXPECT_GT(cache_line_size, sizeof(atomic_counter<TypeParam>));
+    EXPECT_EQ(8 * cache_line_size, sizeof(atomic_counter<TypeParam, 8>));
+}
+
+TYPED_TEST(StripedCounter, AlignOf)
+{
+    EXPECT_EQ(cache_line_size, alignof(atomic_counter<TypeParam, 8>));
+
+    struct holder { char c; atomic_counter<TypeParam, 2> counter; } h;
+    auto address = reinterpret_cast<std::uintptr_t>(&h.counter);
+    EXPECT_EQ(0u, address % cache_line_size);
+}
+
+TYPED_TEST(StripedCounter, ConstructInit)
+{
+    atomic_counter<TypeParam, 4> t(23);
+
+    EXPECT_EQ(TypeParam(23), t.load());
+    EXPECT_EQ(TypeParam(23), TypeParam(t));
+}
+
+TYPED_TEST(StripedCounter, ConstructDefault_Static)
+{
+    static atomic_counter<TypeParam, 4> t;
+
+    EXPECT_EQ(TypeParam(0), t.load());
+}
+
+TYPED_TEST(StripedCounter, Operations)
+{
+    atomic_counter<TypeParam, 4> t(10);
+
+    ++t;
+    t++;
+    t += 5;
+    EXPECT_EQ(TypeParam(17), t.load());
+    --t;
+    t--;
+    t -= 5;
+    EXPECT_EQ(TypeParam(10), t.load());
+}
+
+TYPED_TEST(StripedCounter, Operations_volatile)
+{
+    volatile atomic_counter<TypeParam, 4> t(10);
+
+    ++t;
+    t += 5;
+    --t;
+    t -= 2;
+    EXPECT_EQ(TypeParam(13), t.load());
+}
+
+TYPED_TEST(StripedCounter, IsLockFree)
+{
+    std::atomic<TypeParam> variable;
+    atomic_counter<TypeParam, 4> counter;
+
+    EXPECT_EQ(variable.is_lock_free(), counter.is_lock_free());
+}
+
+TEST(StripedCounter, ConcurrentIncrements)
+{
+    const int threads = 8;
+    const int per_thread = 100000;
+    atomic_counter<long, 4> counter(0);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&counter] {
+            for (int i = 0; i < per_thread; ++i) ++counter;
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    EXPECT_EQ(long(threads) * per_thread, counter.load());
+}
+
+TEST(StripedCounter, DecrementOnOtherThread)
+{
+    atomic_counter<long, 4> counter(0);
+
+    std::thread([&counter] { counter += 5; }).join();
+    std::thread([&counter] { counter -= 7; }).join();
+
+    EXPECT_EQ(-2, counter.load());
+}
@@ -0,0 +1,183 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sky/broadcast_ring.hpp"
+
+using sky::broadcast_ring;
+
+TEST(BroadcastRing, Construct)
+{
+    broadcast_ring<int> ring(8, 2);
+
+    EXPECT_EQ(8u, ring.capacity());
+    EXPECT_EQ(2u, ring.consumer_count());
+}
+
+TEST(BroadcastRing, Construct_NoConsumers)
+{
+    EXPECT_THROW(broadcast_ring<int>(8, 0), std::invalid_argument);
+}
+
+TEST(BroadcastRing, Capacity_RoundedToPowerOfTwo)
+{
+    EXPECT_EQ(1u, broadcast_ring<int>(0, 1).capacity());
+    EXPECT_EQ(4u, broadcast_ring<int>(3, 1).capacity());
+    EXPECT_EQ(1024u, broadcast_ring<int>(1000, 1).capacity());
+}
+
+TEST(BroadcastRing, Poll_Empty)
+{
+    broadcast_ring<int> ring(8, 1);
+    int calls = 0;
+
+    EXPECT_EQ(0u, ring.poll(0, [&calls](int) { ++calls; }));
+    EXPECT_EQ(0, calls);
+}
+
+TEST(BroadcastRing, EveryConsumerSeesEveryElement)
+{
+    broadcast_ring<int> ring(8, 3);
+    std::vector<int> seen[3];
+
+    for (int i = 0; i < 5; ++i) ring.publish(i);
+
+    for (int c = 0; c < 3; ++c) {
+        EXPECT_EQ(5u, ring.poll(c, [&seen, c](int v) {
+            seen[c].push_back(v);
+        }));
+        EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}), seen[c]);
+    }
+}
+
+TEST(BroadcastRing, Poll_MaxN)
+{
+    broadcast_ring<int> ring(8, 1);
+    int sum = 0;
+    auto add = [&sum](int v) { sum += v; };
+
+    for (int i = 1; i <= 5; ++i) ring.publish(i);
+
+    EXPECT_EQ(2u, ring.poll(0, add, 2));
+    EXPECT_EQ(3, sum);
+    EXPECT_EQ(3u, ring.poll(0, add));
+    EXPECT_EQ(15, sum);
+}
+
+TEST(BroadcastRing, TryPublish_SlowestConsumerGates)
+{
+    broadcast_ring<int> ring(4, 2);
+    auto ignore = [](int) {};
+
+    for (int i = 0; i < 4; ++i) EXPECT_TRUE(ring.try_publish(i));
+    EXPECT_FALSE(ring.try_publish(4));
+
+    // Only one of the consumers has caught up.
+    EXPECT_EQ(4u, ring.poll(0, ignore));
+    EXPECT_FALSE(ring.try_publish(4));
+
+    EXPECT_EQ(1u, ring.poll(1, ignore, 1));
+    EXPECT_TRUE(ring.try_publish(4));
+    EXPECT_FALSE(ring.try_publish(5));
+}
+
+TEST(BroadcastRing, TryPublish_RacingProducers)
+{
+    const int producers = 2;
+    const int per_thread = 100000;
+    broadcast_ring<int> ring(4, 1);
+    std::atomic<int> consumed[producers];
+    std::atomic<int> failures(0);
+    std::vector<std::thread> workers;
+
+    for (auto &c : consumed) c.store(0);
+    /*
+     * Every producer keeps at most half of the ring unconsumed, so the ring
+     * always has room when a producer publishes.
+     */
+    for (int t = 0; t < producers; ++t) {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < per_thread; ++i) {
+                while (i - consumed[t].load() >= 2) std::this_thread::yield();
+                if (!ring.try_publish(t)) {
+                    ++failures;
+                    ring.publish(t);
+                }
+            }
+        });
+    }
+    workers.emplace_back([&] {
+        int seen = 0;
+        while (seen < producers * per_thread) {
+            int counts[producers] = {};
+            auto n = ring.poll(0, [&counts](int t) { ++counts[t]; });
+            if (n == 0) std::this_thread::yield();
+            seen += int(n);
+            // Only once poll() has returned are the slots free again.
+            for (int t = 0; t < producers; ++t) consumed[t] += counts[t];
+        }
+    });
+    for (auto &w : workers) w.join();
+
+    EXPECT_EQ(0, failures.load());
+}
+
+TEST(BroadcastRing, PublishWith)
+{
+    broadcast_ring<std::string> ring(4, 1);
+    std::string seen;
+
+    ring.publish_with([](std::string &slot) { slot.assign("abc"); });
+    ring.poll(0, [&seen](std::string const& s) { seen = s; });
+
+    EXPECT_EQ("abc", seen);
+}
+
+TEST(BroadcastRing, Poll_HandlerThrows)
+{
+    broadcast_ring<int> ring(4, 1);
+    std::vector<int> seen;
+
+    ring.publish(1);
+    ring.publish(2);
+    EXPECT_THROW(ring.poll(0, [&seen](int v) {
+        if (v == 2 && seen.size() == 1) throw std::runtime_error("");
+        seen.push_back(v);
+    }), std::runtime_error);
+    ring.poll(0, [&seen](int v) { seen.push_back(v); });
+
+    EXPECT_EQ((std::vector<int>{1, 2}), seen);
+}
+
+TEST(BroadcastRing, MultipleProducersMultipleConsumers)
+{
+    const int producers = 3;
+    const int consumers = 3;
+    const int per_thread = 10000;
+    broadcast_ring<int> ring(64, consumers);
+    std::vector<std::thread> workers;
+    std::vector<long> sums(consumers, 0);
+
+    for (int t = 0; t < producers; ++t) {
+        workers.emplace_back([&ring] {
+            for (int i = 1; i <= per_thread; ++i) ring.publish(i);
+        });
+    }
+    for (int c = 0; c < consumers; ++c) {
+        workers.emplace_back([&ring, &sums, c] {
+            long seen = 0;
+            while (seen < producers * per_thread) {
+                seen += ring.wait(c, [&sums, c](int v) { sums[c] += v; });
+            }
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    for (long sum : sums) {
+        EXPECT_EQ(producers * (long(per_thread) * (per_thread + 1) / 2), sum);
+    }
+}
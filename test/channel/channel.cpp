@@ -0,0 +1,202 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sky/channel.hpp"
+
+using sky::channel;
+using sky::select;
+using sky::select_for;
+using std::chrono::milliseconds;
+
+TEST(Channel, Construct)
+{
+    channel<int>();
+}
+
+TEST(Channel, Capacity)
+{
+    EXPECT_EQ(1024u, channel<int>().capacity());
+    EXPECT_EQ(8u, channel<int>(5).capacity());
+}
+
+TEST(Channel, SendReceive)
+{
+    channel<std::string> c;
+
+    c.send("hello");
+    std::string s("world");
+    c.send(s);
+
+    EXPECT_EQ("hello", c.receive());
+    std::string value;
+    EXPECT_TRUE(c.receive(value));
+    EXPECT_EQ("world", value);
+    EXPECT_TRUE(c.empty());
+}
+
+TEST(Channel, TrySend_Full)
+{
+    channel<int> c(2);
+
+    EXPECT_TRUE(c.try_send(1));
+    EXPECT_TRUE(c.try_send(2));
+    EXPECT_FALSE(c.try_send(3));
+}
+
+TEST(Channel, TryReceive_Empty)
+{
+    channel<int> c;
+    int value = 23;
+
+    EXPECT_FALSE(c.try_receive(value));
+    EXPECT_EQ(23, value);
+}
+
+TEST(Channel, ReceiveFor_Timeout)
+{
+    channel<int> c;
+    int value = 23;
+
+    EXPECT_FALSE(c.receive_for(value, milliseconds(1)));
+    EXPECT_EQ(23, value);
+}
+
+TEST(Channel, Close)
+{
+    channel<int> c;
+
+    c.send(1);
+    c.close();
+    EXPECT_TRUE(c.closed());
+    EXPECT_THROW(c.send(2), sky::queue_closed);
+    EXPECT_FALSE(c.try_send(2));
+
+    int value = 0;
+    EXPECT_TRUE(c.receive(value));
+    EXPECT_EQ(1, value);
+    EXPECT_FALSE(c.receive(value));
+    EXPECT_THROW(c.receive(), sky::queue_closed);
+}
+
+TEST(Channel, Ready)
+{
+    channel<int> c;
+
+    EXPECT_FALSE(c.ready());
+    c.send(1);
+    EXPECT_TRUE(c.ready());
+    c.receive();
+    EXPECT_FALSE(c.ready());
+    c.close();
+    EXPECT_TRUE(c.ready());
+}
+
+TEST(Select, AlreadyReady)
+{
+    channel<int> a;
+    channel<std::string> b;
+
+    b.send("x");
+    EXPECT_EQ(1u, select(a, b));
+    a.send(1);
+    b.receive();
+    EXPECT_EQ(0u, select(a, b));
+}
+
+TEST(Select, Fairness)
+{
+    channel<int> a;
+    channel<int> b;
+    a.send(1);
+    b.send(2);
+
+    bool seen[2] = {false, false};
+    for (int i = 0; i < 10; ++i) seen[select(a, b)] = true;
+    EXPECT_TRUE(seen[0]);
+    EXPECT_TRUE(seen[1]);
+}
+
+TEST(Select, Closed)
+{
+    channel<int> a;
+    channel<int> b;
+
+    b.close();
+    EXPECT_EQ(1u, select(a, b));
+}
+
+TEST(Select, WakesOnSend)
+{
+    channel<int> a;
+    channel<int> b;
+    channel<int> c;
+
+    std::thread sender([&b] {
+        std::this_thread::sleep_for(milliseconds(10));
+        b.send(42);
+    });
+    EXPECT_EQ(1u, select(a, b, c));
+    int value = 0;
+    EXPECT_TRUE(b.try_receive(value));
+    EXPECT_EQ(42, value);
+    sender.join();
+}
+
+TEST(Select, WakesOnClose)
+{
+    channel<int> a;
+    channel<int> b;
+
+    std::thread closer([&a] {
+        std::this_thread::sleep_for(milliseconds(10));
+        a.close();
+    });
+    EXPECT_EQ(0u, select(a, b));
+    closer.join();
+}
+
+TEST(Select, Timeout)
+{
+    channel<int> a;
+    channel<int> b;
+
+    EXPECT_EQ(sky::select_timeout, select_for(milliseconds(5), a, b));
+    b.send(1);
+    EXPECT_EQ(1u, select_for(milliseconds(5), a, b));
+}
+
+TEST(Select, SingleWaiterManyProducers)
+{
+    const int per_channel = 5000;
+    channel<int> control(16);
+    channel<int> data(16);
+    channel<int> timers(16);
+    channel<int> *channels[] = {&control, &data, &timers};
+    std::vector<std::thread> producers;
+
+    for (auto *c : channels) {
+        producers.emplace_back([c] {
+            for (int i = 1; i <= per_channel; ++i) c->send(i);
+        });
+    }
+
+    long sums[3] = {0, 0, 0};
+    for (int received = 0; received < 3 * per_channel; ) {
+        std::size_t i = select(control, data, timers);
+        int value;
+        if (channels[i]->try_receive(value)) {
+            sums[i] += value;
+            ++received;
+        }
+    }
+    for (auto &p : producers) p.join();
+
+    for (long sum : sums) {
+        EXPECT_EQ(long(per_channel) * (per_channel + 1) / 2, sum);
+    }
+}
@@ -0,0 +1,167 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "sky/concurrent_priority_queue.hpp"
+
+using sky::concurrent_priority_queue;
+
+TEST(ConcurrentPriorityQueue, Construct)
+{
+    concurrent_priority_queue<int>();
+}
+
+TEST(ConcurrentPriorityQueue, ShardCount)
+{
+    EXPECT_EQ(3u, concurrent_priority_queue<int>(3).shard_count());
+    EXPECT_LE(2u, concurrent_priority_queue<int>().shard_count());
+}
+
+TEST(ConcurrentPriorityQueue, Empty)
+{
+    concurrent_priority_queue<int> q(4);
+
+    EXPECT_TRUE(q.empty());
+    q.push(1);
+    EXPECT_FALSE(q.empty());
+    q.pop();
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(ConcurrentPriorityQueue, TryPop_Empty)
+{
+    concurrent_priority_queue<int> q(4);
+    int value = 23;
+
+    EXPECT_FALSE(q.try_pop(value));
+    EXPECT_EQ(23, value);
+}
+
+TEST(ConcurrentPriorityQueue, SingleShard_HighestPriorityFirst)
+{
+    concurrent_priority_queue<int> q(1);
+    int values[] = {3, 1, 4, 1, 5, 9, 2, 6};
+
+    for (int v : values) q.push(v);
+
+    std::sort(std::begin(values), std::end(values), std::greater<int>());
+    for (int v : values) EXPECT_EQ(v, q.pop());
+}
+
+TEST(ConcurrentPriorityQueue, SingleShard_Compare)
+{
+    concurrent_priority_queue<int, std::greater<int>> q(1);
+    int value;
+
+    q.push(2);
+    q.push(1);
+    q.push(3);
+
+    EXPECT_TRUE(q.try_pop(value));
+    EXPECT_EQ(1, value);
+    EXPECT_EQ(2, q.pop());
+    EXPECT_EQ(3, q.pop());
+}
+
+TEST(ConcurrentPriorityQueue, Sharded_PopsEveryElement)
+{
+    concurrent_priority_queue<int> q(8);
+    std::vector<int> popped;
+    int value;
+
+    for (int i = 0; i < 1000; ++i) q.push(i);
+    while (q.try_pop(value)) popped.push_back(value);
+
+    std::sort(popped.begin(), popped.end());
+    ASSERT_EQ(1000u, popped.size());
+    for (int i = 0; i < 1000; ++i) EXPECT_EQ(i, popped[i]);
+}
+
+TEST(ConcurrentPriorityQueue, Sharded_ApproximatelyOrdered)
+{
+    concurrent_priority_queue<int> q(4);
+    long first_half = 0;
+
+    for (int i = 0; i < 1000; ++i) q.push(i);
+    for (int i = 0; i < 500; ++i) first_half += q.pop();
+
+    // A FIFO or random order would average 499.5 per element.
+    EXPECT_LT(600 * 500, first_half);
+}
+
+TEST(ConcurrentPriorityQueue, Emplace)
+{
+    concurrent_priority_queue<std::pair<int, char>> q(1);
+
+    q.emplace(1, 'a');
+    q.emplace(2, 'b');
+
+    EXPECT_EQ(std::make_pair(2, 'b'), q.pop());
+    EXPECT_EQ(std::make_pair(1, 'a'), q.pop());
+}
+
+struct deref_less
+{
+    bool operator ()(std::unique_ptr<int> const& a,
+                     std::unique_ptr<int> const& b) const
+    {
+        return *a < *b;
+    }
+};
+
+TEST(ConcurrentPriorityQueue, MoveOnly)
+{
+    concurrent_priority_queue<std::unique_ptr<int>, deref_less> q(1);
+    std::unique_ptr<int> value;
+
+    q.push(std::unique_ptr<int>(new int(1)));
+    q.push(std::unique_ptr<int>(new int(42)));
+
+    EXPECT_EQ(42, *q.pop());
+    EXPECT_TRUE(q.try_pop(value));
+    EXPECT_EQ(1, *value);
+}
+
+TEST(ConcurrentPriorityQueue, Pop_WaitsForPush)
+{
+    concurrent_priority_queue<int> q(4);
+
+    std::thread producer([&q] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        q.push(42);
+    });
+
+    EXPECT_EQ(42, q.pop());
+    producer.join();
+}
+
+TEST(ConcurrentPriorityQueue, MultipleProducersMultipleConsumers)
+{
+    const int threads = 4;
+    const int per_thread = 10000;
+    concurrent_priority_queue<int> q(8);
+    std::vector<std::thread> workers;
+    std::atomic<long> total(0);
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&q] {
+            for (int i = 1; i <= per_thread; ++i) q.push(i);
+        });
+        workers.emplace_back([&q, &total] {
+            long sum = 0;
+            for (int i = 0; i < per_thread; ++i) sum += q.pop();
+            total += sum;
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    EXPECT_EQ(threads * (long(per_thread) * (per_thread + 1) / 2),
+              total.load());
+    EXPECT_TRUE(q.empty());
+}
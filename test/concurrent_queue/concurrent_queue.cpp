@@ -1,10 +1,654 @@
 #include "gtest/gtest.h"
 
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "sky/concurrent_queue.hpp"
 
+#include "../counting_allocator.hpp"
+
 using sky::concurrent_queue;
 
 TEST(ConcurrentQueue, Construct)
 {
     concurrent_queue<int>();
 }
+
+TEST(ConcurrentQueue, Capacity_RoundedToPowerOfTwo)
+{
+    EXPECT_EQ(2u, concurrent_queue<int>(0).capacity());
+    EXPECT_EQ(2u, concurrent_queue<int>(1).capacity());
+    EXPECT_EQ(2u, concurrent_queue<int>(2).capacity());
+    EXPECT_EQ(4u, concurrent_queue<int>(3).capacity());
+    EXPECT_EQ(1024u, concurrent_queue<int>(1000).capacity());
+    EXPECT_EQ(1024u, concurrent_queue<int>().capacity());
+}
+
+TEST(ConcurrentQueue, Empty)
+{
+    concurrent_queue<int> q;
+
+    EXPECT_TRUE(q.empty());
+    q.push(1);
+    EXPECT_FALSE(q.empty());
+    q.pop();
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(ConcurrentQueue, TryPop_Empty)
+{
+    concurrent_queue<int> q;
+    int value = 23;
+
+    EXPECT_FALSE(q.try_pop(value));
+    EXPECT_EQ(23, value);
+}
+
+TEST(ConcurrentQueue, TryPush_Full)
+{
+    concurrent_queue<int> q(4);
+
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(q.try_push(i));
+    }
+    EXPECT_FALSE(q.try_push(4));
+
+    int value;
+    EXPECT_TRUE(q.try_pop(value));
+    EXPECT_TRUE(q.try_push(4));
+}
+
+TEST(ConcurrentQueue, FirstInFirstOut)
+{
+    concurrent_queue<int> q(4);
+
+    // Go around the ring a few times.
+    for (int i = 0; i < 10; ++i) {
+        q.push(2*i);
+        q.push(2*i + 1);
+        EXPECT_EQ(2*i, q.pop());
+        EXPECT_EQ(2*i + 1, q.pop());
+    }
+}
+
+TEST(ConcurrentQueue, Emplace)
+{
+    concurrent_queue<std::pair<int, char>> q;
+
+    q.emplace(1, 'a');
+    EXPECT_TRUE(q.try_emplace(2, 'b'));
+
+    EXPECT_EQ(std::make_pair(1, 'a'), q.pop());
+    EXPECT_EQ(std::make_pair(2, 'b'), q.pop());
+}
+
+TEST(ConcurrentQueue, MoveOnly)
+{
+    concurrent_queue<std::unique_ptr<int>> q;
+
+    q.push(std::unique_ptr<int>(new int(42)));
+
+    EXPECT_EQ(42, *q.pop());
+}
+
+TEST(ConcurrentQueue, DestroysRemainingElements)
+{
+    auto value = std::make_shared<int>(0);
+    {
+        concurrent_queue<std::shared_ptr<int>> q(4);
+        q.push(value);
+        q.push(value);
+        q.push(value);
+        q.pop();
+        EXPECT_EQ(3, value.use_count());
+    }
+    EXPECT_EQ(1, value.use_count());
+}
+
+TEST(ConcurrentQueue, MoveConstruct)
+{
+    concurrent_queue<int> q(4);
+    q.push(1);
+
+    concurrent_queue<int> moved(std::move(q));
+
+    EXPECT_EQ(4u, moved.capacity());
+    EXPECT_EQ(1, moved.pop());
+}
+
+TEST(ConcurrentQueue, MovedFrom_Assign)
+{
+    concurrent_queue<int> q(4);
+    q.push(1);
+    concurrent_queue<int> moved(std::move(q));
+
+    q = concurrent_queue<int>(2);
+    q.push(2);
+
+    EXPECT_EQ(2u, q.capacity());
+    EXPECT_EQ(2, q.pop());
+    EXPECT_EQ(1, moved.pop());
+}
+
+TEST(ConcurrentQueue, Swap)
+{
+    concurrent_queue<int> a(2), b(8);
+    a.push(1);
+    b.push(2);
+
+    a.swap(b);
+
+    EXPECT_EQ(8u, a.capacity());
+    EXPECT_EQ(2, a.pop());
+    EXPECT_EQ(1, b.pop());
+}
+
+TEST(ConcurrentQueue, MultipleProducersMultipleConsumers)
+{
+    const int threads = 4;
+    const int per_thread = 10000;
+    concurrent_queue<int> q(64);
+    std::vector<std::thread> workers;
+    std::vector<long> sums(threads, 0);
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&q, t] {
+            for (int i = 1; i <= per_thread; ++i) q.push(i);
+        });
+        workers.emplace_back([&q, &sums, t] {
+            for (int i = 0; i < per_thread; ++i) sums[t] += q.pop();
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    long total = 0;
+    for (long s : sums) total += s;
+    EXPECT_EQ(threads * (long(per_thread) * (per_thread + 1) / 2), total);
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(ConcurrentQueue, WaitPop_WaitsForPush)
+{
+    concurrent_queue<int> q;
+
+    std::thread producer([&q] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        q.push(42);
+    });
+
+    EXPECT_EQ(42, q.wait_pop());
+    producer.join();
+}
+
+TEST(ConcurrentQueue, WaitPopFor_Available)
+{
+    concurrent_queue<int> q;
+    int value = 0;
+    q.push(42);
+
+    EXPECT_TRUE(q.wait_pop_for(value, std::chrono::milliseconds(10)));
+    EXPECT_EQ(42, value);
+}
+
+TEST(ConcurrentQueue, WaitPopFor_Timeout)
+{
+    concurrent_queue<int> q;
+    int value = 23;
+    auto start = std::chrono::steady_clock::now();
+
+    EXPECT_FALSE(q.wait_pop_for(value, std::chrono::milliseconds(10)));
+    EXPECT_LE(std::chrono::milliseconds(10),
+              std::chrono::steady_clock::now() - start);
+    EXPECT_EQ(23, value);
+}
+
+TEST(ConcurrentQueue, WaitPopUntil_Timeout)
+{
+    concurrent_queue<int> q;
+    int value = 23;
+
+    EXPECT_FALSE(q.wait_pop_until(value, std::chrono::steady_clock::now()));
+    EXPECT_EQ(23, value);
+}
+
+TEST(ConcurrentQueue, WaitPopUntil_WaitsForPush)
+{
+    concurrent_queue<int> q;
+    int value = 0;
+
+    std::thread producer([&q] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        q.push(42);
+    });
+
+    EXPECT_TRUE(q.wait_pop_until(value, std::chrono::steady_clock::now()
+                                        + std::chrono::seconds(10)));
+    EXPECT_EQ(42, value);
+    producer.join();
+}
+
+TEST(ConcurrentQueue, WaitPop_ManySleepers)
+{
+    const int consumers = 8;
+    concurrent_queue<int> q;
+    std::vector<std::thread> workers;
+    std::atomic<int> total(0);
+
+    for (int t = 0; t < consumers; ++t) {
+        workers.emplace_back([&q, &total] { total += q.wait_pop(); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (int t = 1; t <= consumers; ++t) q.push(t);
+    for (auto &w : workers) w.join();
+
+    EXPECT_EQ(consumers * (consumers + 1) / 2, total.load());
+}
+
+TEST(ConcurrentQueue, PushRange)
+{
+    concurrent_queue<int> q(8);
+    int values[] = {1, 2, 3, 4, 5};
+
+    q.push_range(std::begin(values), std::end(values));
+
+    for (int v : values) EXPECT_EQ(v, q.pop());
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(ConcurrentQueue, PushRange_NotTriviallyCopyable)
+{
+    concurrent_queue<std::string> q(8);
+    std::vector<std::string> values = {"a", "b", "c"};
+
+    q.push_range(values.begin(), values.end());
+
+    for (auto const& v : values) EXPECT_EQ(v, q.pop());
+}
+
+TEST(ConcurrentQueue, PopInto)
+{
+    concurrent_queue<int> q(8);
+    for (int i = 0; i < 5; ++i) q.push(i);
+    int out[8] = {};
+
+    EXPECT_EQ(3u, q.pop_into(out, 3));
+    EXPECT_EQ(2u, q.pop_into(out + 3, 8));
+    EXPECT_EQ(0u, q.pop_into(out, 8));
+
+    for (int i = 0; i < 5; ++i) EXPECT_EQ(i, out[i]);
+}
+
+TEST(ConcurrentQueue, PopInto_BackInserter)
+{
+    concurrent_queue<std::string> q(8);
+    q.push("a");
+    q.push("b");
+    std::vector<std::string> out;
+
+    EXPECT_EQ(2u, q.pop_into(std::back_inserter(out), 8));
+
+    EXPECT_EQ((std::vector<std::string>{"a", "b"}), out);
+}
+
+namespace {
+
+// Stores elements into a vector, and throws once it holds a given number.
+struct throwing_output
+{
+    std::vector<std::shared_ptr<int>> *into;
+    std::size_t limit;
+
+    throwing_output &operator *() { return *this; }
+    throwing_output &operator ++() { return *this; }
+
+    throwing_output &operator =(std::shared_ptr<int> &&value)
+    {
+        if (into->size() == limit) throw std::runtime_error("full");
+        into->push_back(std::move(value));
+        return *this;
+    }
+};
+
+} // namespace
+
+TEST(ConcurrentQueue, PopInto_OutputThrows)
+{
+    concurrent_queue<std::shared_ptr<int>> q(4);
+    auto value = std::make_shared<int>(42);
+    for (int i = 0; i < 4; ++i) q.push(value);
+    std::vector<std::shared_ptr<int>> out;
+
+    EXPECT_THROW(q.pop_into(throwing_output{&out, 1}, 4), std::runtime_error);
+
+    // The elements that were not moved out were destroyed.
+    EXPECT_EQ(1u, out.size());
+    EXPECT_EQ(2, value.use_count());
+    // And their slots are free again.
+    for (int i = 0; i < 4; ++i) EXPECT_TRUE(q.try_push(value));
+    EXPECT_FALSE(q.try_push(value));
+}
+
+namespace {
+
+// Moves without throwing, but throws when move-assigned a negative value.
+struct throwing_assign
+{
+    int value;
+
+    throwing_assign(int value = 0) : value(value) {}
+    throwing_assign(throwing_assign &&other) noexcept : value(other.value) {}
+
+    throwing_assign &operator =(throwing_assign &&other)
+    {
+        if (other.value < 0) throw std::runtime_error("negative");
+        value = other.value;
+        return *this;
+    }
+};
+
+} // namespace
+
+TEST(ConcurrentQueue, TryPop_AssignmentThrows)
+{
+    concurrent_queue<throwing_assign> q(2);
+    q.push(throwing_assign(-1));
+    q.push(throwing_assign(1));
+    throwing_assign out;
+
+    EXPECT_THROW(q.try_pop(out), std::runtime_error);
+
+    // The slot of the element that could not be assigned is free again.
+    EXPECT_TRUE(q.try_push(throwing_assign(2)));
+    EXPECT_TRUE(q.try_pop(out));
+    EXPECT_EQ(1, out.value);
+    EXPECT_TRUE(q.try_pop(out));
+    EXPECT_EQ(2, out.value);
+}
+
+TEST(ConcurrentQueue, Range_WrapsAround)
+{
+    concurrent_queue<int> q(4);
+    int values[] = {1, 2, 3};
+    int out[3];
+
+    for (int lap = 0; lap < 5; ++lap) {
+        q.push_range(std::begin(values), std::end(values));
+        EXPECT_EQ(3u, q.pop_into(out, 3));
+        for (int i = 0; i < 3; ++i) EXPECT_EQ(values[i], out[i]);
+    }
+}
+
+TEST(ConcurrentQueue, Range_MultipleProducersMultipleConsumers)
+{
+    const int threads = 4;
+    const int batches = 1000;
+    const int batch = 16;
+    concurrent_queue<int> q(64);
+    std::vector<std::thread> workers;
+    std::atomic<long> total(0);
+    std::atomic<int> popped(0);
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&q] {
+            int values[batch];
+            for (int i = 0; i < batch; ++i) values[i] = i + 1;
+            for (int b = 0; b < batches; ++b) {
+                q.push_range(std::begin(values), std::end(values));
+            }
+        });
+        workers.emplace_back([&q, &total, &popped] {
+            int out[batch];
+            while (popped.load() < threads * batches * batch) {
+                int n = q.pop_into(out, batch);
+                if (n == 0) std::this_thread::yield();
+                long sum = 0;
+                for (int i = 0; i < n; ++i) sum += out[i];
+                total += sum;
+                popped += n;
+            }
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    EXPECT_EQ(long(threads) * batches * (batch * (batch + 1) / 2),
+              total.load());
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(ConcurrentQueue, Push_WaitsForRoom)
+{
+    concurrent_queue<int> q(2);
+    q.push(1);
+    q.push(2);
+    std::atomic<bool> pushed(false);
+
+    std::thread producer([&q, &pushed] {
+        q.push(3);
+        pushed = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    EXPECT_FALSE(pushed.load());
+
+    EXPECT_EQ(1, q.pop());
+    producer.join();
+    EXPECT_TRUE(pushed.load());
+    EXPECT_EQ(2, q.pop());
+    EXPECT_EQ(3, q.pop());
+}
+
+TEST(ConcurrentQueue, Close)
+{
+    concurrent_queue<int> q;
+
+    EXPECT_FALSE(q.closed());
+    q.close();
+    EXPECT_TRUE(q.closed());
+    q.close();
+    EXPECT_TRUE(q.closed());
+}
+
+TEST(ConcurrentQueue, Close_PushFails)
+{
+    concurrent_queue<int> q;
+    int values[] = {1, 2};
+    q.close();
+
+    EXPECT_FALSE(q.try_push(1));
+    EXPECT_FALSE(q.try_emplace(1));
+    EXPECT_THROW(q.push(1), sky::queue_closed);
+    EXPECT_THROW(q.push_range(std::begin(values), std::end(values)),
+                 sky::queue_closed);
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(ConcurrentQueue, Close_DrainsRemainingElements)
+{
+    concurrent_queue<int> q;
+    q.push(1);
+    q.push(2);
+    q.close();
+    int value = 0;
+
+    EXPECT_FALSE(q.empty());
+    EXPECT_EQ(1, q.pop());
+    EXPECT_TRUE(q.wait_pop(value));
+    EXPECT_EQ(2, value);
+    EXPECT_FALSE(q.wait_pop(value));
+    EXPECT_FALSE(q.wait_pop_for(value, std::chrono::seconds(10)));
+    EXPECT_THROW(q.pop(), sky::queue_closed);
+    EXPECT_EQ(2, value);
+}
+
+TEST(ConcurrentQueue, Close_WakesConsumers)
+{
+    const int consumers = 4;
+    concurrent_queue<int> q;
+    std::vector<std::thread> workers;
+    std::atomic<int> ended(0);
+
+    for (int t = 0; t < consumers; ++t) {
+        workers.emplace_back([&q, &ended] {
+            int value;
+            if (!q.wait_pop(value)) ++ended;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    q.close();
+    for (auto &w : workers) w.join();
+
+    EXPECT_EQ(consumers, ended.load());
+}
+
+TEST(ConcurrentQueue, Close_WakesProducers)
+{
+    concurrent_queue<int> q(2);
+    q.push(1);
+    q.push(2);
+
+    std::thread producer([&q] {
+        EXPECT_THROW(q.push(3), sky::queue_closed);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    q.close();
+    producer.join();
+
+    EXPECT_EQ(1, q.pop());
+    EXPECT_EQ(2, q.pop());
+}
+
+TEST(ConcurrentQueue, Close_Pipeline)
+{
+    const int producers = 4;
+    const int per_thread = 10000;
+    concurrent_queue<int> q(16);
+    std::vector<std::thread> workers;
+    std::atomic<long> total(0);
+
+    for (int t = 0; t < producers; ++t) {
+        workers.emplace_back([&q] {
+            for (int i = 1; i <= per_thread; ++i) q.push(i);
+        });
+    }
+    std::vector<std::thread> consumers;
+    for (int t = 0; t < producers; ++t) {
+        consumers.emplace_back([&q, &total] {
+            int value;
+            while (q.wait_pop(value)) total += value;
+        });
+    }
+    for (auto &w : workers) w.join();
+    q.close();
+    for (auto &c : consumers) c.join();
+
+    EXPECT_EQ(producers * (long(per_thread) * (per_thread + 1) / 2),
+              total.load());
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(ConcurrentQueue, Stats_Disabled)
+{
+    concurrent_queue<int> q;
+
+    q.stats();
+}
+
+TEST(ConcurrentQueue, Stats_CountsPushesAndPops)
+{
+    concurrent_queue<int, sky::queue_stats> q(8);
+    int values[] = {4, 5, 6};
+    int out[4];
+
+    q.push(1);
+    EXPECT_TRUE(q.try_push(2));
+    q.emplace(3);
+    q.push_range(std::begin(values), std::end(values));
+    q.pop();
+    EXPECT_EQ(2u, q.pop_into(out, 2));
+
+    auto stats = q.stats();
+    EXPECT_EQ(6u, stats.pushes);
+    EXPECT_EQ(3u, stats.pops);
+    EXPECT_EQ(3u, stats.depth);
+    EXPECT_EQ(6u, stats.high_water);
+    EXPECT_EQ(0u, stats.producer_blocks);
+    EXPECT_EQ(0u, stats.consumer_blocks);
+}
+
+TEST(ConcurrentQueue, Stats_Blocking)
+{
+    concurrent_queue<int, sky::queue_stats> q(2);
+
+    // The first pop waits for the producer, which then fills the queue and
+    // waits for the consumer.
+    std::thread producer([&q] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        for (int i = 0; i < 4; ++i) q.push(i);
+    });
+    q.pop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    for (int i = 1; i < 4; ++i) q.pop();
+    producer.join();
+
+    auto stats = q.stats();
+    EXPECT_LE(1u, stats.consumer_blocks);
+    EXPECT_LE(1u, stats.producer_blocks);
+    EXPECT_EQ(2u, stats.high_water);
+}
+
+TEST(ConcurrentQueue, Stats_WaitTime)
+{
+    concurrent_queue<int, sky::queue_stats> q;
+
+    q.push(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    q.push(2);
+    q.pop();
+    q.pop();
+
+    auto stats = q.stats();
+    EXPECT_LE(std::chrono::milliseconds(10), stats.max_wait);
+    EXPECT_LE(stats.max_wait, stats.total_wait);
+}
+
+TEST(ConcurrentQueue, Stats_Swap)
+{
+    concurrent_queue<int, sky::queue_stats> a(4), b(4);
+    a.push(1);
+
+    a.swap(b);
+
+    EXPECT_EQ(0u, a.stats().pushes);
+    EXPECT_EQ(1u, b.stats().pushes);
+    EXPECT_EQ(1, b.pop());
+    EXPECT_EQ(1u, b.stats().pops);
+}
+
+TEST(ConcurrentQueue, Allocator_OnlyAtConstruction)
+{
+    std::atomic<long> live(0);
+    {
+        typedef concurrent_queue<std::string, sky::null_queue_stats,
+                                 counting_allocator<std::string>> queue_type;
+        queue_type q(16, counting_allocator<std::string>(&live));
+        long constructed = live.load();
+        EXPECT_LT(0, constructed);
+        EXPECT_EQ(&live, q.get_allocator().live);
+
+        for (int i = 0; i < 100; ++i) {
+            q.push("x");
+            EXPECT_EQ("x", q.pop());
+        }
+        EXPECT_EQ(constructed, live.load());
+
+        queue_type moved(std::move(q));
+        EXPECT_EQ(constructed, live.load());
+        EXPECT_EQ(&live, moved.get_allocator().live);
+    }
+    EXPECT_EQ(0, live.load());
+}
@@ -0,0 +1,50 @@
+#ifndef COUNTING_ALLOCATOR_HPP
+#define COUNTING_ALLOCATOR_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/*
+ * An allocator that counts the allocations made through it and its copies
+ * that have not been deallocated yet.
+ */
+template<typename T>
+struct counting_allocator
+{
+    typedef T value_type;
+
+    explicit counting_allocator(std::atomic<long> *live) : live(live) {}
+
+    template<typename U>
+    counting_allocator(counting_allocator<U> const& other) : live(other.live)
+    {}
+
+    T *allocate(std::size_t n)
+    {
+        ++*live;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, std::size_t n)
+    {
+        --*live;
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    std::atomic<long> *live;
+};
+
+template<typename T, typename U>
+bool operator ==(counting_allocator<T> const& a, counting_allocator<U> const& b)
+{
+    return a.live == b.live;
+}
+
+template<typename T, typename U>
+bool operator !=(counting_allocator<T> const& a, counting_allocator<U> const& b)
+{
+    return !(a == b);
+}
+
+#endif // COUNTING_ALLOCATOR_HPP
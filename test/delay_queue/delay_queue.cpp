@@ -0,0 +1,191 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "sky/delay_queue.hpp"
+
+using sky::delay_queue;
+using std::chrono::milliseconds;
+
+typedef delay_queue<int>::clock clock_type;
+
+TEST(DelayQueue, Construct)
+{
+    delay_queue<int>();
+}
+
+TEST(DelayQueue, Empty)
+{
+    delay_queue<int> q;
+
+    EXPECT_TRUE(q.empty());
+    EXPECT_EQ(0u, q.size());
+    q.push(1, clock_type::now());
+    EXPECT_FALSE(q.empty());
+    EXPECT_EQ(1u, q.size());
+    q.pop();
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(DelayQueue, TryPop_NotDue)
+{
+    delay_queue<int> q;
+    int value = 23;
+
+    q.push(1, clock_type::now() + std::chrono::hours(1));
+
+    EXPECT_FALSE(q.try_pop(value));
+    EXPECT_EQ(23, value);
+    EXPECT_EQ(1u, q.size());
+}
+
+TEST(DelayQueue, TryPop_Due)
+{
+    delay_queue<int> q;
+    int value = 0;
+
+    q.push(42, clock_type::now());
+
+    EXPECT_TRUE(q.try_pop(value));
+    EXPECT_EQ(42, value);
+}
+
+TEST(DelayQueue, DeadlineOrder)
+{
+    delay_queue<int> q;
+    auto now = clock_type::now();
+
+    q.push(3, now - milliseconds(1));
+    q.push(1, now - milliseconds(3));
+    q.push(2, now - milliseconds(2));
+
+    EXPECT_EQ(1, q.pop());
+    EXPECT_EQ(2, q.pop());
+    EXPECT_EQ(3, q.pop());
+}
+
+TEST(DelayQueue, EqualDeadlines_FirstInFirstOut)
+{
+    delay_queue<int> q;
+    auto now = clock_type::now();
+
+    for (int i = 0; i < 10; ++i) q.push(i, now);
+    for (int i = 0; i < 10; ++i) EXPECT_EQ(i, q.pop());
+}
+
+TEST(DelayQueue, Pop_WaitsForDeadline)
+{
+    delay_queue<int> q;
+    auto deadline = clock_type::now() + milliseconds(10);
+
+    q.push(42, deadline);
+
+    EXPECT_EQ(42, q.pop());
+    EXPECT_LE(deadline, clock_type::now());
+}
+
+TEST(DelayQueue, Pop_WokenByEarlierDeadline)
+{
+    delay_queue<int> q;
+    q.push(1, clock_type::now() + std::chrono::hours(1));
+
+    std::thread producer([&q] {
+        std::this_thread::sleep_for(milliseconds(10));
+        q.push(2, clock_type::now());
+    });
+
+    EXPECT_EQ(2, q.pop());
+    producer.join();
+}
+
+TEST(DelayQueue, PopUntil_Timeout)
+{
+    delay_queue<int> q;
+    int value = 23;
+    q.push(1, clock_type::now() + std::chrono::hours(1));
+    auto until = clock_type::now() + milliseconds(10);
+
+    EXPECT_FALSE(q.pop_until(value, until));
+    EXPECT_LE(until, clock_type::now());
+    EXPECT_EQ(23, value);
+}
+
+TEST(DelayQueue, PopUntil_Due)
+{
+    delay_queue<int> q;
+    int value = 0;
+    q.push(42, clock_type::now() + milliseconds(10));
+
+    EXPECT_TRUE(q.pop_until(value, clock_type::now() + std::chrono::hours(1)));
+    EXPECT_EQ(42, value);
+}
+
+TEST(DelayQueue, MoveOnly)
+{
+    delay_queue<std::unique_ptr<int>> q;
+
+    q.push(std::unique_ptr<int>(new int(42)), clock_type::now());
+
+    EXPECT_EQ(42, *q.pop());
+}
+
+TEST(DelayQueue, ManyConsumers)
+{
+    const int consumers = 4;
+    delay_queue<int> q;
+    std::vector<std::thread> workers;
+    std::vector<int> popped(consumers, 0);
+
+    for (int t = 0; t < consumers; ++t) {
+        workers.emplace_back([&q, &popped, t] { popped[t] = q.pop(); });
+    }
+    std::this_thread::sleep_for(milliseconds(10));
+    auto now = clock_type::now();
+    for (int t = 1; t <= consumers; ++t) q.push(t, now + milliseconds(t));
+    for (auto &w : workers) w.join();
+
+    int sum = 0;
+    for (int v : popped) sum += v;
+    EXPECT_EQ(consumers * (consumers + 1) / 2, sum);
+}
+
+TEST(DelayQueue, PopUntil_TimeoutPassesWakeupOn)
+{
+    for (int round = 0; round < 10; ++round) {
+        delay_queue<int> q;
+        std::atomic<bool> popped(false);
+
+        std::thread timed_consumer([&q] {
+            int value;
+            q.pop_until(value, clock_type::now() + milliseconds(20));
+        });
+        std::this_thread::sleep_for(milliseconds(5));
+        // Sleeps without a deadline, since the queue is empty.
+        std::thread consumer([&q, &popped] {
+            q.pop();
+            popped = true;
+        });
+        std::this_thread::sleep_for(milliseconds(5));
+
+        /*
+         * The single wakeup for this push may reach the timed consumer,
+         * which then times out before the element is due.
+         */
+        q.push(1, clock_type::now() + milliseconds(30));
+        timed_consumer.join();
+
+        auto give_up = clock_type::now() + std::chrono::seconds(1);
+        while (!popped && clock_type::now() < give_up) {
+            std::this_thread::sleep_for(milliseconds(1));
+        }
+        EXPECT_TRUE(popped) << "round " << round;
+        // Unblocks the consumer if the wakeup was lost.
+        if (!popped) q.push(2, clock_type::now());
+        consumer.join();
+        if (!popped) break;
+    }
+}
@@ -0,0 +1,179 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sky/flat_combining_queue.hpp"
+
+using sky::flat_combining_queue;
+
+TEST(FlatCombiningQueue, Construct)
+{
+    flat_combining_queue<int>();
+}
+
+TEST(FlatCombiningQueue, Capacity)
+{
+    EXPECT_EQ(1024u, flat_combining_queue<int>().capacity());
+    EXPECT_EQ(2u, flat_combining_queue<int>(0).capacity());
+    EXPECT_EQ(8u, flat_combining_queue<int>(5).capacity());
+    EXPECT_EQ(16u, flat_combining_queue<int>(16).capacity());
+}
+
+TEST(FlatCombiningQueue, Empty)
+{
+    flat_combining_queue<int> q;
+
+    EXPECT_TRUE(q.empty());
+    q.push(1);
+    EXPECT_FALSE(q.empty());
+    q.pop();
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(FlatCombiningQueue, TryPop_Empty)
+{
+    flat_combining_queue<int> q;
+    int value = 23;
+
+    EXPECT_FALSE(q.try_pop(value));
+    EXPECT_EQ(23, value);
+}
+
+TEST(FlatCombiningQueue, Fifo)
+{
+    flat_combining_queue<int> q(8);
+
+    for (int i = 0; i < 8; ++i) EXPECT_TRUE(q.try_push(i));
+    for (int i = 0; i < 8; ++i) {
+        int value = -1;
+        EXPECT_TRUE(q.try_pop(value));
+        EXPECT_EQ(i, value);
+    }
+}
+
+TEST(FlatCombiningQueue, TryPush_Full)
+{
+    flat_combining_queue<int> q(2);
+
+    EXPECT_TRUE(q.try_push(1));
+    EXPECT_TRUE(q.try_push(2));
+    EXPECT_FALSE(q.try_push(3));
+    EXPECT_EQ(1, q.pop());
+    EXPECT_TRUE(q.try_push(3));
+}
+
+TEST(FlatCombiningQueue, Wraparound)
+{
+    flat_combining_queue<int> q(4);
+
+    for (int i = 0; i < 100; ++i) {
+        q.push(i);
+        q.push(i + 1000);
+        EXPECT_EQ(i, q.pop());
+        EXPECT_EQ(i + 1000, q.pop());
+    }
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(FlatCombiningQueue, MoveOnly)
+{
+    flat_combining_queue<std::unique_ptr<int>> q;
+
+    q.push(std::unique_ptr<int>(new int(7)));
+    EXPECT_TRUE(q.try_emplace(new int(8)));
+    q.emplace(new int(9));
+
+    EXPECT_EQ(7, *q.pop());
+    std::unique_ptr<int> p;
+    EXPECT_TRUE(q.try_pop(p));
+    EXPECT_EQ(8, *p);
+    EXPECT_EQ(9, *q.pop());
+}
+
+TEST(FlatCombiningQueue, Copy)
+{
+    flat_combining_queue<std::string> q;
+    std::string s("hello");
+
+    q.push(s);
+    EXPECT_TRUE(q.try_push(s));
+    EXPECT_EQ("hello", s);
+    EXPECT_EQ("hello", q.pop());
+    EXPECT_EQ("hello", q.pop());
+}
+
+TEST(FlatCombiningQueue, Destroy_Remaining)
+{
+    auto counter = std::make_shared<int>(0);
+    {
+        flat_combining_queue<std::shared_ptr<int>> q(4);
+        q.push(counter);
+        q.push(counter);
+        EXPECT_EQ(3, counter.use_count());
+    }
+    EXPECT_EQ(1, counter.use_count());
+}
+
+TEST(FlatCombiningQueue, MultiProducerMultiConsumer)
+{
+    const int producers = 4;
+    const int consumers = 4;
+    const int per_producer = 10000;
+    flat_combining_queue<int> q(64);
+    std::atomic<long> sum(0);
+    std::atomic<int> popped(0);
+    std::vector<std::thread> threads;
+
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < producers * per_producer / consumers; ++i) {
+                sum += q.pop();
+                ++popped;
+            }
+        });
+    }
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&q, p] {
+            for (int i = 0; i < per_producer; ++i) {
+                q.push(p * per_producer + i);
+            }
+        });
+    }
+    for (auto &t : threads) t.join();
+
+    long n = producers * per_producer;
+    EXPECT_EQ(n, popped.load());
+    EXPECT_EQ(n * (n - 1) / 2, sum.load());
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(FlatCombiningQueue, PerProducerOrder)
+{
+    const int producers = 3;
+    const int per_producer = 5000;
+    flat_combining_queue<int> q(16);
+    std::vector<std::thread> threads;
+
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&q, p] {
+            for (int i = 0; i < per_producer; ++i) {
+                q.push(p * per_producer + i);
+            }
+        });
+    }
+
+    std::vector<int> last(producers, -1);
+    bool ordered = true;
+    for (int i = 0; i < producers * per_producer; ++i) {
+        int value = q.pop();
+        int p = value / per_producer;
+        if (value <= last[p]) ordered = false;
+        last[p] = value;
+    }
+    for (auto &t : threads) t.join();
+    EXPECT_TRUE(ordered);
+}
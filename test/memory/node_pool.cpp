@@ -0,0 +1,126 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "sky/memory.hpp"
+#include "sky/node_pool.hpp"
+
+#include "../counting_allocator.hpp"
+
+using sky::node_pool;
+
+namespace {
+
+struct node
+{
+    node() : value(42), next(nullptr) {}
+
+    int value;
+    node *next;
+};
+
+} // namespace
+
+TEST(NodePool, Construct_DoesNotAllocate)
+{
+    std::atomic<long> live(0);
+    {
+        node_pool<node, counting_allocator<node>> pool(
+                8, counting_allocator<node>(&live));
+        EXPECT_EQ(0, live.load());
+        EXPECT_EQ(0u, pool.chunk_count());
+        EXPECT_EQ(8u, pool.chunk_size());
+    }
+    EXPECT_EQ(0, live.load());
+}
+
+TEST(NodePool, ChunkSize_AtLeastOne)
+{
+    node_pool<node> pool(0);
+
+    EXPECT_EQ(1u, pool.chunk_size());
+    EXPECT_NE(nullptr, pool.allocate_chunk());
+}
+
+TEST(NodePool, AllocateChunk_DefaultConstructs)
+{
+    node_pool<node> pool(16);
+
+    node *chunk = pool.allocate_chunk();
+    for (int i = 0; i < 16; ++i) {
+        EXPECT_EQ(42, chunk[i].value);
+        EXPECT_EQ(nullptr, chunk[i].next);
+    }
+    EXPECT_EQ(1u, pool.chunk_count());
+}
+
+TEST(NodePool, Destroy_ReturnsChunks)
+{
+    std::atomic<long> live(0);
+    {
+        node_pool<node, counting_allocator<node>> pool(
+                4, counting_allocator<node>(&live));
+        pool.allocate_chunk();
+        pool.allocate_chunk();
+        pool.allocate_chunk();
+        EXPECT_EQ(3u, pool.chunk_count());
+        EXPECT_LT(0, live.load());
+    }
+    EXPECT_EQ(0, live.load());
+}
+
+TEST(NodePool, GetAllocator)
+{
+    std::atomic<long> live(0);
+    counting_allocator<int> alloc(&live);
+    node_pool<node, counting_allocator<int>> pool(4, alloc);
+
+    EXPECT_EQ(&live, pool.get_allocator().live);
+}
+
+TEST(NodePool, AllocateChunk_Concurrent)
+{
+    const int threads = 4;
+    const int chunks = 100;
+    node_pool<node> pool(8);
+    std::vector<std::vector<node *>> seen(threads);
+    std::vector<std::thread> workers;
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&pool, &seen, t] {
+            for (int i = 0; i < chunks; ++i) {
+                seen[t].push_back(pool.allocate_chunk());
+            }
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    std::set<node *> distinct;
+    for (auto const& s : seen) distinct.insert(s.begin(), s.end());
+    EXPECT_EQ(std::size_t(threads * chunks), distinct.size());
+    EXPECT_EQ(std::size_t(threads * chunks), pool.chunk_count());
+}
+
+TEST(AllocateUnique, ValueInitializes)
+{
+    auto p = sky::allocate_unique<int>(std::allocator<char>(), 10);
+
+    for (int i = 0; i < 10; ++i) EXPECT_EQ(0, p[i]);
+}
+
+TEST(AllocateUnique, ReturnsToAllocator)
+{
+    std::atomic<long> live(0);
+    {
+        auto p = sky::allocate_unique<long>(
+                counting_allocator<char>(&live), 5);
+        EXPECT_EQ(1, live.load());
+        EXPECT_EQ(&live, p.get_deleter().get_allocator().live);
+    }
+    EXPECT_EQ(0, live.load());
+}
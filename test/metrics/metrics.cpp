@@ -0,0 +1,207 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sky/metrics.h"
+#include "sky/os.h"
+#include "sky/scope_guard.hpp"
+
+using namespace sky;
+
+namespace {
+
+std::string format(metrics_registry &registry)
+{
+    std::size_t length;
+    char const *text = registry.format(length);
+    return std::string(text, length);
+}
+
+} // namespace
+
+TEST(MetricsRegistry, Empty)
+{
+    metrics_registry registry;
+    EXPECT_EQ(0u, registry.size());
+    EXPECT_EQ("", format(registry));
+}
+
+TEST(MetricsRegistry, Counter)
+{
+    atomic_counter<long> requests(0);
+    metrics_registry registry;
+    registry.add("requests_total", "Requests served.", requests);
+    requests += 42;
+
+    EXPECT_EQ(1u, registry.size());
+    EXPECT_EQ("# HELP requests_total Requests served.\n"
+              "# TYPE requests_total counter\n"
+              "requests_total 42\n",
+              format(registry));
+}
+
+TEST(MetricsRegistry, CounterValues)
+{
+    atomic_counter<int> negative(-7);
+    atomic_counter<unsigned long long, 4> large(~0ull);
+    metrics_registry registry;
+    registry.add("negative", "", negative);
+    registry.add("large", "", large);
+
+    std::string text = format(registry);
+    EXPECT_NE(std::string::npos, text.find("\nnegative -7\n"));
+    EXPECT_NE(std::string::npos, text.find("\nlarge 18446744073709551615\n"));
+}
+
+TEST(MetricsRegistry, ReadsCurrentValue)
+{
+    atomic_counter<long> counter(0);
+    metrics_registry registry;
+    registry.add("events", "Events.", counter);
+
+    EXPECT_NE(std::string::npos, format(registry).find("events 0\n"));
+    ++counter;
+    EXPECT_NE(std::string::npos, format(registry).find("events 1\n"));
+    // Exporting must not reset the counter.
+    EXPECT_EQ(1, counter.load());
+}
+
+TEST(MetricsRegistry, Histogram)
+{
+    atomic_histogram<> latency;
+    for (unsigned i = 1; i <= 10; ++i) latency.record(i);
+    metrics_registry registry;
+    registry.add("latency_ns", "Latency.", latency);
+
+    EXPECT_EQ("# HELP latency_ns Latency.\n"
+              "# TYPE latency_ns summary\n"
+              "latency_ns{quantile=\"0.5\"} 5\n"
+              "latency_ns{quantile=\"0.9\"} 9\n"
+              "latency_ns{quantile=\"0.99\"} 10\n"
+              "latency_ns{quantile=\"0.999\"} 10\n"
+              "latency_ns_sum 55\n"
+              "latency_ns_count 10\n",
+              format(registry));
+    // Exporting must not reset the histogram.
+    EXPECT_EQ(10u, latency.load().count());
+}
+
+TEST(MetricsRegistry, EscapesHelp)
+{
+    atomic_counter<int> counter(0);
+    metrics_registry registry;
+    registry.add("c", "back\\slash\nnewline", counter);
+    EXPECT_EQ(0u, format(registry).find("# HELP c back\\\\slash\\nnewline\n"));
+}
+
+TEST(MetricsRegistry, InvalidName)
+{
+    atomic_counter<int> counter(0);
+    metrics_registry registry;
+    EXPECT_THROW(registry.add("", "", counter), std::invalid_argument);
+    EXPECT_THROW(registry.add("1st", "", counter), std::invalid_argument);
+    EXPECT_THROW(registry.add("a-b", "", counter), std::invalid_argument);
+    EXPECT_THROW(registry.add("a b", "", counter), std::invalid_argument);
+    EXPECT_NO_THROW(registry.add("_a:b9", "", counter));
+    EXPECT_EQ(1u, registry.size());
+}
+
+TEST(MetricsRegistry, DuplicateName)
+{
+    atomic_counter<int> counter(0);
+    atomic_histogram<> histogram;
+    metrics_registry registry;
+    registry.add("metric", "", counter);
+    EXPECT_THROW(registry.add("metric", "", histogram),
+                 std::invalid_argument);
+    EXPECT_EQ(1u, registry.size());
+}
+
+TEST(MetricsRegistry, LongNamesFit)
+{
+    std::string name(200, 'x');
+    atomic_counter<unsigned long long> counter(~0ull);
+    atomic_histogram<> histogram;
+    histogram.record(~std::uint64_t(0), ~std::uint64_t(0));
+    metrics_registry registry;
+    registry.add(name + "_c", std::string(300, 'h'), counter);
+    registry.add(name + "_h", std::string(300, 'h'), histogram);
+
+    std::string text = format(registry);
+    EXPECT_NE(std::string::npos, text.find("_c 18446744073709551615\n"));
+    EXPECT_NE(std::string::npos, text.find("_h_count 18446744073709551615\n"));
+}
+
+TEST(MetricsRegistry, AddWhileExporting)
+{
+    const int count = 200;
+    std::vector<atomic_counter<int>> counters(count);
+    metrics_registry registry;
+    std::atomic<bool> done(false);
+
+    std::thread exporter([&] {
+        std::size_t length;
+        while (!done) registry.format(length);
+    });
+    for (int i = 0; i < count; ++i) {
+        registry.add("counter_" + std::to_string(i), "", counters[i]);
+    }
+    done = true;
+    exporter.join();
+
+    EXPECT_EQ(std::size_t(count), registry.size());
+    EXPECT_NE(std::string::npos, format(registry).find("\ncounter_199 0\n"));
+}
+
+TEST(MetricsRegistry, ExportToPipe)
+{
+    auto pipe = make_pipe();
+    input &in = std::get<0>(pipe);
+    output &out = std::get<1>(pipe);
+    auto close_in = scope_guard([&] { in.close(); });
+    auto close_out = scope_guard([&] { out.close(); });
+
+    atomic_counter<long> counter(3);
+    metrics_registry registry;
+    registry.add("exported", "Exported.", counter);
+
+    std::string expected = format(registry);
+    ASSERT_EQ(expected.size(), registry.export_to(out));
+
+    char actual[256] = {};
+    ASSERT_EQ(expected.size(), in.read(actual, sizeof(actual)));
+    EXPECT_EQ(expected, std::string(actual));
+}
+
+TEST(MetricsExporter, ExportsPeriodicallyAndOnStop)
+{
+    auto pipe = make_pipe();
+    input &in = std::get<0>(pipe);
+    output &out = std::get<1>(pipe);
+    auto close_in = scope_guard([&] { in.close(); });
+    auto close_out = scope_guard([&] { out.close(); });
+
+    atomic_counter<long> counter(1);
+    metrics_registry registry;
+    registry.add("ticks", "", counter);
+    std::size_t length = format(registry).size();
+
+    char buf[64];
+    {
+        metrics_exporter exporter(registry, out,
+                                  std::chrono::milliseconds(10));
+        // At least one periodic export arrives while the exporter runs.
+        ASSERT_EQ(length, in.read(buf, length));
+        EXPECT_EQ(format(registry), std::string(buf, length));
+    }
+    // And a last one when it stops.
+    ASSERT_EQ(length, in.read(buf, length));
+    EXPECT_EQ(format(registry), std::string(buf, length));
+}
@@ -0,0 +1,166 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "sky/sharded_queue.hpp"
+
+using sky::sharded_queue;
+
+TEST(ShardedQueue, Construct)
+{
+    sharded_queue<int>();
+}
+
+TEST(ShardedQueue, ShardCount)
+{
+    EXPECT_EQ(3u, sharded_queue<int>(3).shard_count());
+    EXPECT_LE(1u, sharded_queue<int>().shard_count());
+}
+
+TEST(ShardedQueue, Empty)
+{
+    sharded_queue<int> q(4);
+
+    EXPECT_TRUE(q.empty());
+    q.push(1);
+    EXPECT_FALSE(q.empty());
+    q.pop();
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(ShardedQueue, TryPop_Empty)
+{
+    sharded_queue<int> q(4);
+    int value = 23;
+
+    EXPECT_FALSE(q.try_pop(value));
+    EXPECT_EQ(23, value);
+}
+
+TEST(ShardedQueue, SameThread_FirstInFirstOut)
+{
+    sharded_queue<int> q(4);
+
+    for (int i = 0; i < 10; ++i) q.push(i);
+    for (int i = 0; i < 10; ++i) EXPECT_EQ(i, q.pop());
+}
+
+TEST(ShardedQueue, TryPush_SpillsIntoOtherShards)
+{
+    sharded_queue<int> q(3, 2);
+    int value;
+
+    for (int i = 0; i < 6; ++i) EXPECT_TRUE(q.try_push(i));
+    EXPECT_FALSE(q.try_push(6));
+
+    EXPECT_TRUE(q.try_pop(value));
+    EXPECT_TRUE(q.try_push(6));
+}
+
+TEST(ShardedQueue, Steal)
+{
+    sharded_queue<int> q(4);
+
+    std::thread producer([&q] {
+        for (int i = 0; i < 10; ++i) q.push(i);
+    });
+    producer.join();
+
+    // Whichever shard the producer used, this thread finds its elements.
+    for (int i = 0; i < 10; ++i) EXPECT_EQ(i, q.pop());
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(ShardedQueue, Emplace)
+{
+    sharded_queue<std::pair<int, char>> q(2);
+
+    q.emplace(1, 'a');
+    EXPECT_TRUE(q.try_emplace(2, 'b'));
+
+    EXPECT_EQ(std::make_pair(1, 'a'), q.pop());
+    EXPECT_EQ(std::make_pair(2, 'b'), q.pop());
+}
+
+TEST(ShardedQueue, MoveOnly)
+{
+    sharded_queue<std::unique_ptr<int>> q(2);
+
+    q.push(std::unique_ptr<int>(new int(42)));
+
+    EXPECT_EQ(42, *q.pop());
+}
+
+TEST(ShardedQueue, Pop_NotDefaultConstructible)
+{
+    struct no_default
+    {
+        explicit no_default(int v) : v(v) {}
+        int v;
+    };
+    sharded_queue<no_default> q(2);
+
+    q.emplace(42);
+
+    EXPECT_EQ(42, q.pop().v);
+}
+
+TEST(ShardedQueue, Pop_WaitsForPush)
+{
+    sharded_queue<int> q(4);
+
+    // Long enough for the consumer to stop spinning and park.
+    std::thread producer([&q] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        q.push(42);
+    });
+
+    EXPECT_EQ(42, q.pop());
+    producer.join();
+}
+
+TEST(ShardedQueue, Pop_ManyParkedConsumers)
+{
+    const int consumers = 4;
+    sharded_queue<int> q(2);
+    std::vector<std::thread> workers;
+    std::atomic<int> total(0);
+
+    for (int t = 0; t < consumers; ++t) {
+        workers.emplace_back([&q, &total] { total += q.pop(); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    for (int i = 1; i <= consumers; ++i) q.push(i);
+    for (auto &w : workers) w.join();
+
+    EXPECT_EQ(consumers * (consumers + 1) / 2, total.load());
+}
+
+TEST(ShardedQueue, MultipleProducersMultipleConsumers)
+{
+    const int threads = 4;
+    const int per_thread = 10000;
+    sharded_queue<int> q(threads, 64);
+    std::vector<std::thread> workers;
+    std::atomic<long> total(0);
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&q] {
+            for (int i = 1; i <= per_thread; ++i) q.push(i);
+        });
+        workers.emplace_back([&q, &total] {
+            long sum = 0;
+            for (int i = 0; i < per_thread; ++i) sum += q.pop();
+            total += sum;
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    EXPECT_EQ(threads * (long(per_thread) * (per_thread + 1) / 2),
+              total.load());
+    EXPECT_TRUE(q.empty());
+}
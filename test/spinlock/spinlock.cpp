@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <sky/spinlock.hpp>
+
+using namespace sky;
+
+template<typename Lock>
+class Spinlock : public testing::Test {};
+
+typedef testing::Types<ttas_spinlock, ticket_spinlock,
+                       mcs_spinlock, clh_spinlock> Spinlocks;
+
+TYPED_TEST_CASE(Spinlock, Spinlocks);
+
+TYPED_TEST(Spinlock, TypeTraits)
+{
+    using namespace std;
+
+    EXPECT_TRUE (is_default_constructible<TypeParam>::value);
+    EXPECT_FALSE(is_copy_constructible<TypeParam>::value);
+    EXPECT_FALSE(is_copy_assignable<TypeParam>::value);
+}
+
+TYPED_TEST(Spinlock, UsableWithLockGuard)
+{
+    TypeParam lock;
+    {
+        std::lock_guard<TypeParam> guard(lock);
+    }
+    std::lock_guard<TypeParam> again(lock);
+}
+
+TYPED_TEST(Spinlock, RelockManyTimes)
+{
+    TypeParam lock;
+    for (unsigned i = 0; i < 10000; ++i) {
+        lock.lock();
+        lock.unlock();
+    }
+}
+
+TYPED_TEST(Spinlock, HoldSeveral)
+{
+    TypeParam a, b, c;
+    std::lock_guard<TypeParam> ga(a);
+    std::lock_guard<TypeParam> gb(b);
+    std::lock_guard<TypeParam> gc(c);
+}
+
+TYPED_TEST(Spinlock, UnlockInOtherOrder)
+{
+    TypeParam a, b;
+    for (unsigned i = 0; i < 100; ++i) {
+        a.lock();
+        b.lock();
+        a.unlock();
+        b.unlock();
+    }
+}
+
+TYPED_TEST(Spinlock, MutualExclusion)
+{
+    const unsigned threads = 4;
+    const unsigned iterations = 20000;
+    TypeParam lock;
+    unsigned long total = 0;
+
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (unsigned i = 0; i < iterations; ++i) {
+                std::lock_guard<TypeParam> guard(lock);
+                ++total;
+            }
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    EXPECT_EQ(threads * iterations, total);
+}
+
+template<typename Lock>
+class TrySpinlock : public testing::Test {};
+
+typedef testing::Types<ttas_spinlock, ticket_spinlock,
+                       mcs_spinlock> TrySpinlocks;
+
+TYPED_TEST_CASE(TrySpinlock, TrySpinlocks);
+
+TYPED_TEST(TrySpinlock, TryLock)
+{
+    TypeParam lock;
+
+    EXPECT_TRUE(lock.try_lock());
+    EXPECT_FALSE(lock.try_lock());
+    lock.unlock();
+    EXPECT_TRUE(lock.try_lock());
+    lock.unlock();
+}
+
+TYPED_TEST(TrySpinlock, TryLockFromOtherThread)
+{
+    TypeParam lock;
+    bool acquired = true;
+
+    lock.lock();
+    std::thread other([&] { acquired = lock.try_lock(); });
+    other.join();
+    EXPECT_FALSE(acquired);
+    lock.unlock();
+
+    std::thread again([&] {
+        acquired = lock.try_lock();
+        if (acquired) lock.unlock();
+    });
+    again.join();
+    EXPECT_TRUE(acquired);
+}
+
+TYPED_TEST(TrySpinlock, UsableWithUniqueLock)
+{
+    TypeParam lock;
+    std::unique_lock<TypeParam> guard(lock, std::try_to_lock);
+
+    EXPECT_TRUE(guard.owns_lock());
+}
+
+TEST(TicketSpinlock, GrantsInArrivalOrder)
+{
+    const unsigned threads = 4;
+    ticket_spinlock lock;
+    std::vector<unsigned> order;
+
+    lock.lock();
+    std::vector<std::thread> waiters;
+    for (unsigned t = 0; t < threads; ++t) {
+        waiters.emplace_back([&, t] {
+            std::lock_guard<ticket_spinlock> guard(lock);
+            order.push_back(t);
+        });
+        // Let the thread draw its ticket before the next one starts.
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    lock.unlock();
+    for (auto &w : waiters) w.join();
+
+    ASSERT_EQ(threads, order.size());
+    for (unsigned t = 0; t < threads; ++t) EXPECT_EQ(t, order[t]);
+}
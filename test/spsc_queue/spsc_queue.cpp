@@ -0,0 +1,114 @@
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <thread>
+
+#include "sky/spsc_queue.hpp"
+
+using sky::spsc_queue;
+
+TEST(SpscQueue, Construct)
+{
+    spsc_queue<int, 16>();
+}
+
+TEST(SpscQueue, Capacity)
+{
+    EXPECT_EQ(16u, (spsc_queue<int, 16>::capacity()));
+}
+
+TEST(SpscQueue, Empty)
+{
+    spsc_queue<int, 4> q;
+
+    EXPECT_TRUE(q.empty());
+    q.push(1);
+    EXPECT_FALSE(q.empty());
+    q.pop();
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(SpscQueue, TryPop_Empty)
+{
+    spsc_queue<int, 4> q;
+    int value = 23;
+
+    EXPECT_FALSE(q.try_pop(value));
+    EXPECT_EQ(23, value);
+}
+
+TEST(SpscQueue, TryPush_Full)
+{
+    spsc_queue<int, 4> q;
+
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(q.try_push(i));
+    }
+    EXPECT_FALSE(q.try_push(4));
+
+    int value;
+    EXPECT_TRUE(q.try_pop(value));
+    EXPECT_EQ(0, value);
+    EXPECT_TRUE(q.try_push(4));
+}
+
+TEST(SpscQueue, FirstInFirstOut)
+{
+    spsc_queue<int, 2> q;
+
+    for (int i = 0; i < 10; ++i) {
+        q.push(2*i);
+        q.push(2*i + 1);
+        EXPECT_EQ(2*i, q.pop());
+        EXPECT_EQ(2*i + 1, q.pop());
+    }
+}
+
+TEST(SpscQueue, Emplace)
+{
+    spsc_queue<std::pair<int, char>, 4> q;
+
+    q.emplace(1, 'a');
+    EXPECT_TRUE(q.try_emplace(2, 'b'));
+
+    EXPECT_EQ(std::make_pair(1, 'a'), q.pop());
+    EXPECT_EQ(std::make_pair(2, 'b'), q.pop());
+}
+
+TEST(SpscQueue, MoveOnly)
+{
+    spsc_queue<std::unique_ptr<int>, 4> q;
+
+    q.push(std::unique_ptr<int>(new int(42)));
+
+    EXPECT_EQ(42, *q.pop());
+}
+
+TEST(SpscQueue, DestroysRemainingElements)
+{
+    auto value = std::make_shared<int>(0);
+    {
+        spsc_queue<std::shared_ptr<int>, 4> q;
+        q.push(value);
+        q.push(value);
+        q.pop();
+        EXPECT_EQ(2, value.use_count());
+    }
+    EXPECT_EQ(1, value.use_count());
+}
+
+TEST(SpscQueue, ProducerConsumer)
+{
+    const int count = 100000;
+    spsc_queue<int, 64> q;
+
+    std::thread producer([&q] {
+        for (int i = 0; i < count; ++i) q.push(i);
+    });
+
+    for (int i = 0; i < count; ++i) {
+        ASSERT_EQ(i, q.pop());
+    }
+    producer.join();
+    EXPECT_TRUE(q.empty());
+}
@@ -0,0 +1,167 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "sky/unbounded_queue.hpp"
+
+#include "../counting_allocator.hpp"
+
+using sky::unbounded_queue;
+
+TEST(UnboundedQueue, Construct)
+{
+    unbounded_queue<int>();
+}
+
+TEST(UnboundedQueue, Empty)
+{
+    unbounded_queue<int> q;
+
+    EXPECT_TRUE(q.empty());
+    q.push(1);
+    EXPECT_FALSE(q.empty());
+    q.pop();
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(UnboundedQueue, TryPop_Empty)
+{
+    unbounded_queue<int> q;
+    int value = 23;
+
+    EXPECT_FALSE(q.try_pop(value));
+    EXPECT_EQ(23, value);
+}
+
+TEST(UnboundedQueue, FirstInFirstOut)
+{
+    unbounded_queue<int> q;
+
+    for (int i = 0; i < 1000; ++i) q.push(i);
+    for (int i = 0; i < 1000; ++i) EXPECT_EQ(i, q.pop());
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(UnboundedQueue, Emplace)
+{
+    unbounded_queue<std::pair<int, char>> q;
+
+    q.emplace(1, 'a');
+
+    EXPECT_EQ(std::make_pair(1, 'a'), q.pop());
+}
+
+TEST(UnboundedQueue, MoveOnly)
+{
+    unbounded_queue<std::unique_ptr<int>> q;
+
+    q.push(std::unique_ptr<int>(new int(42)));
+
+    EXPECT_EQ(42, *q.pop());
+}
+
+TEST(UnboundedQueue, NotDefaultConstructible)
+{
+    struct value
+    {
+        explicit value(int i) : i(i) {}
+        int i;
+    };
+    unbounded_queue<value> q;
+
+    q.emplace(42);
+
+    EXPECT_EQ(42, q.pop().i);
+}
+
+TEST(UnboundedQueue, DestroysRemainingElements)
+{
+    auto value = std::make_shared<int>(0);
+    {
+        unbounded_queue<std::shared_ptr<int>> q;
+        for (int i = 0; i < 100; ++i) q.push(value);
+        for (int i = 0; i < 50; ++i) q.pop();
+        EXPECT_EQ(51, value.use_count());
+    }
+    EXPECT_EQ(1, value.use_count());
+}
+
+TEST(UnboundedQueue, ThrowingConstructor)
+{
+    struct throws
+    {
+        explicit throws(bool fail) { if (fail) throw 42; }
+    };
+    unbounded_queue<throws> q;
+
+    EXPECT_THROW(q.emplace(true), int);
+    EXPECT_TRUE(q.empty());
+    q.emplace(false);
+    EXPECT_FALSE(q.empty());
+}
+
+TEST(UnboundedQueue, MultipleProducersMultipleConsumers)
+{
+    const int threads = 4;
+    const int per_thread = 20000;
+    unbounded_queue<int> q;
+    std::vector<std::thread> workers;
+    std::vector<long> sums(threads, 0);
+
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&q] {
+            for (int i = 1; i <= per_thread; ++i) q.push(i);
+        });
+        workers.emplace_back([&q, &sums, t] {
+            for (int i = 0; i < per_thread; ++i) sums[t] += q.pop();
+        });
+    }
+    for (auto &w : workers) w.join();
+
+    long total = 0;
+    for (long s : sums) total += s;
+    EXPECT_EQ(threads * (long(per_thread) * (per_thread + 1) / 2), total);
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(UnboundedQueue, Allocator_SteadyStateDoesNotAllocate)
+{
+    std::atomic<long> live(0);
+    {
+        counting_allocator<int> alloc(&live);
+        unbounded_queue<int, counting_allocator<int>> q(alloc);
+        EXPECT_EQ(&live, q.get_allocator().live);
+
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 0; i < 1000; ++i) q.push(i);
+            for (int i = 0; i < 1000; ++i) EXPECT_EQ(i, q.pop());
+        }
+        long warmed_up = live.load();
+
+        for (int round = 0; round < 10; ++round) {
+            for (int i = 0; i < 1000; ++i) q.push(i);
+            for (int i = 0; i < 1000; ++i) q.pop();
+        }
+        EXPECT_EQ(warmed_up, live.load());
+    }
+    EXPECT_EQ(0, live.load());
+}
+
+TEST(UnboundedQueue, Allocator_DestroyRemaining)
+{
+    std::atomic<long> live(0);
+    auto counter = std::make_shared<int>(0);
+    {
+        counting_allocator<std::shared_ptr<int>> alloc(&live);
+        unbounded_queue<std::shared_ptr<int>,
+                        counting_allocator<std::shared_ptr<int>>> q(alloc);
+        for (int i = 0; i < 200; ++i) q.push(counter);
+        q.pop();
+        EXPECT_EQ(200, counter.use_count());
+    }
+    EXPECT_EQ(1, counter.use_count());
+    EXPECT_EQ(0, live.load());
+}